@@ -0,0 +1,132 @@
+#include <iostream>
+#include <chrono>
+#include <mmappet/mmappet.h>
+
+// Batched random row and group lookups: one operator[] / get_group call at a time versus
+// Dataset::gather and IndexedDataset::gather_groups in their different modes.
+// Usage: ./gather_benchmark [number of rows] [batch size] [scratch directory]
+
+template<typename F>
+void bench(const char* name, size_t batch_size, F&& run)
+{
+    auto start = std::chrono::steady_clock::now();
+    double checksum = run();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << "\t" << std::chrono::duration<double, std::nano>(elapsed).count() / batch_size
+              << " ns/id\t(checksum " << checksum << ")\n";
+}
+
+int main(int argc, char** argv)
+{
+    const size_t no_rows = argc > 1 ? std::stoul(argv[1]) : 16000000;
+    const size_t batch_size = argc > 2 ? std::stoul(argv[2]) : 1000000;
+    const std::filesystem::path path = argc > 3 ? argv[3] : "./gather_benchmark.tmp";
+
+    Schema<uint64_t, uint32_t, double, float> schema("a", "b", "c", "d");
+    std::filesystem::remove_all(path);
+    {
+        // Groups of 1 to 16 rows
+        auto writer = schema.create_indexed_writer(path);
+        std::vector<uint64_t> a(16);
+        std::vector<uint32_t> b(16);
+        std::vector<double> c(16);
+        std::vector<float> d(16);
+        for(size_t row = 0; row < no_rows;)
+        {
+            size_t n = std::min<size_t>(1 + row % 16, no_rows - row);
+            for(size_t ii = 0; ii < n; ++ii)
+            {
+                a[ii] = row + ii;
+                b[ii] = static_cast<uint32_t>(row + ii);
+                c[ii] = (row + ii) * 0.5;
+                d[ii] = (row + ii) * 0.25f;
+            }
+            writer.write_group(n, a.data(), b.data(), c.data(), d.data());
+            row += n;
+        }
+    }
+
+    auto indexed = schema.open_indexed_dataset(path);
+    auto dataset = schema.open_dataset(path);
+
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto next_random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    std::vector<size_t> row_ids(batch_size);
+    for(auto& row : row_ids)
+        row = next_random() % no_rows;
+    const size_t no_groups = batch_size / 8;
+    std::vector<size_t> group_ids(no_groups);
+    for(auto& group : group_ids)
+        group = next_random() % indexed.number_of_groups();
+
+    // Fault both mappings in first, so that the first variant measured doesn't pay for it
+    double warmup = 0.0;
+    for(auto row : dataset)
+        warmup += std::get<0>(row);
+    for(size_t group = 0; group < indexed.number_of_groups(); ++group)
+        warmup += std::get<3>(indexed.get_group(group)).size();
+
+    std::cout << no_rows << " rows, " << indexed.number_of_groups() << " groups, "
+              << batch_size << " row ids, " << no_groups << " group ids\t(warmup checksum " << warmup << ")\n";
+
+    auto checksum = [](const auto& columns) {
+        const auto& [a, b, c, d] = columns;
+        double sum = 0.0;
+        for(size_t ii = 0; ii < a.size(); ++ii)
+            sum += a[ii] + b[ii] + c[ii] + d[ii];
+        return sum;
+    };
+
+    bench("operator[] loop", batch_size, [&]() {
+        std::tuple<std::vector<uint64_t>, std::vector<uint32_t>, std::vector<double>, std::vector<float>> out;
+        auto& [a, b, c, d] = out;
+        for(size_t row : row_ids)
+        {
+            auto [va, vb, vc, vd] = dataset[row];
+            a.push_back(va);
+            b.push_back(vb);
+            c.push_back(vc);
+            d.push_back(vd);
+        }
+        return checksum(out);
+    });
+
+    const std::pair<const char*, GatherMode> modes[] = {
+        {"Default", GatherMode::Default},
+        {"Bucketed", GatherMode::Bucketed},
+        {"WillNeed", GatherMode::WillNeed},
+        {"Bucketed|WillNeed", GatherMode::Bucketed | GatherMode::WillNeed},
+        {"Parallel", GatherMode::Parallel},
+        {"Bucketed|Parallel", GatherMode::Bucketed | GatherMode::Parallel},
+    };
+    for(const auto& [name, mode] : modes)
+        bench((std::string("gather ") + name).c_str(), batch_size, [&, mode = mode]() {
+            return checksum(dataset.gather(row_ids, mode));
+        });
+
+    bench("get_group loop", no_groups, [&]() {
+        std::tuple<std::vector<uint64_t>, std::vector<uint32_t>, std::vector<double>, std::vector<float>> out;
+        auto& [a, b, c, d] = out;
+        for(size_t group : group_ids)
+        {
+            auto [ga, gb, gc, gd] = indexed.get_group(group);
+            a.insert(a.end(), ga.begin(), ga.end());
+            b.insert(b.end(), gb.begin(), gb.end());
+            c.insert(c.end(), gc.begin(), gc.end());
+            d.insert(d.end(), gd.begin(), gd.end());
+        }
+        return checksum(out);
+    });
+
+    for(const auto& [name, mode] : modes)
+        bench((std::string("gather_groups ") + name).c_str(), no_groups, [&, mode = mode]() {
+            return checksum(indexed.gather_groups(group_ids, mode).columns);
+        });
+
+    std::filesystem::remove_all(path);
+}
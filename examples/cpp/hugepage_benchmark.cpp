@@ -0,0 +1,126 @@
+#include <iostream>
+#include <chrono>
+#include <mmappet/mmappet.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+// Random row lookups over a large column, with and without huge pages, counting dTLB load misses.
+// Usage: ./hugepage_benchmark [column size in MiB] [number of lookups] [scratch directory]
+// For MapMode::HugePages to get file-backed huge pages, point the scratch directory at a tmpfs
+// mounted with huge=always or huge=within_size. MapMode::AnonHugePages uses hugetlbfs pages when
+// vm.nr_hugepages is set, and transparent huge pages otherwise.
+
+// Counts dTLB read misses of this thread, if perf events are available
+class TLBMissCounter {
+    int fd = -1;
+public:
+    TLBMissCounter()
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~TLBMissCounter()
+    {
+        if(fd != -1)
+            close(fd);
+    }
+    bool available() const { return fd != -1; }
+    void start()
+    {
+        if(fd == -1) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+        if(fd == -1) return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
+};
+
+// Huge page usage of the whole process, as reported by the kernel
+static std::string huge_page_usage()
+{
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string line, result;
+    while(std::getline(smaps, line))
+        if(line.rfind("AnonHugePages", 0) == 0 || line.rfind("FilePmdMapped", 0) == 0 || line.rfind("ShmemPmdMapped", 0) == 0)
+            result += " " + line.substr(0, line.find(':')) + "=" + std::to_string(std::stoul(line.substr(line.find(':') + 1))) + "kB";
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t size_mib = argc > 1 ? std::stoul(argv[1]) : 1024;
+    const size_t no_lookups = argc > 2 ? std::stoul(argv[2]) : 10000000;
+    const std::filesystem::path path = argc > 3 ? argv[3] : "./hugepage_benchmark.tmp";
+    const size_t no_rows = (size_mib << 20) / sizeof(uint64_t);
+
+    Schema<uint64_t> schema("Value");
+    {
+        std::filesystem::remove_all(path);
+        auto writer = schema.create_writer(path);
+        std::vector<uint64_t> chunk(1 << 16);
+        for(size_t row = 0; row < no_rows; row += chunk.size())
+        {
+            size_t n = std::min(chunk.size(), no_rows - row);
+            for(size_t ii = 0; ii < n; ++ii)
+                chunk[ii] = row + ii;
+            writer.write_rows(n, chunk.data());
+        }
+    }
+
+    TLBMissCounter counter;
+    std::cout << size_mib << " MiB column, " << no_lookups << " random lookups"
+              << (counter.available() ? "" : " (perf events unavailable, no TLB miss counts)") << "\n";
+
+    const std::pair<const char*, MapMode> modes[] = {
+        {"MapMode::Default", MapMode::Default},
+        {"MapMode::HugePages", MapMode::HugePages},
+        {"MapMode::AnonHugePages", MapMode::AnonHugePages},
+    };
+    for(const auto& [name, mode] : modes)
+    {
+        auto dataset = schema.open_dataset(path, true, mode);
+        auto& column = dataset.get_column<0>();
+
+        // Fault everything in first, so that only TLB behaviour differs between the runs
+        uint64_t checksum = 0;
+        for(size_t row = 0; row < column.size(); row += 512)
+            checksum += column[row];
+
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        counter.start();
+        auto start = std::chrono::steady_clock::now();
+        for(size_t ii = 0; ii < no_lookups; ++ii)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            checksum += std::get<0>(dataset[state % no_rows]);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t misses = counter.stop();
+
+        std::cout << name << "\t" << std::chrono::duration<double, std::nano>(elapsed).count() / no_lookups << " ns/lookup";
+        if(counter.available())
+            std::cout << "\t" << static_cast<double>(misses) / no_lookups << " dTLB misses/lookup";
+        if(mode == MapMode::AnonHugePages)
+            std::cout << "\t" << (column.is_hugetlb_backed() ? "hugetlbfs" : "THP fallback");
+        std::cout << "\t" << huge_page_usage() << "\t(checksum " << checksum << ")\n";
+    }
+
+    std::filesystem::remove_all(path);
+}
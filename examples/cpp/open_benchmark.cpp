@@ -0,0 +1,107 @@
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <mmappet/mmappet.h>
+
+// Measures how long it takes to open (and touch) many small datasets, with the different ways of opening them.
+// Usage: ./open_benchmark [number of datasets] [rounds] [scratch directory]
+
+using BenchSchema = Schema<uint64_t, uint32_t, double, float, int64_t, int32_t, uint16_t, uint8_t>;
+
+template<typename F>
+void bench(const char* name, size_t no_datasets, size_t rounds, F&& open_one)
+{
+    double checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t round = 0; round < rounds; ++round)
+        for(size_t ii = 0; ii < no_datasets; ++ii)
+            checksum += open_one(ii);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double us_per_open = std::chrono::duration<double, std::micro>(elapsed).count() / (no_datasets * rounds);
+    std::cout << name << "\t" << us_per_open << " us/open\t(checksum " << checksum << ")\n";
+}
+
+int main(int argc, char** argv)
+{
+    const size_t no_datasets = argc > 1 ? std::stoul(argv[1]) : 500;
+    const size_t rounds = argc > 2 ? std::stoul(argv[2]) : 10;
+    const size_t no_rows = 1000;
+
+    BenchSchema schema("a", "b", "c", "d", "e", "f", "g", "h");
+    const std::filesystem::path root = argc > 3 ? argv[3] : "./open_benchmark.tmp";
+    std::filesystem::remove_all(root);
+
+    std::vector<std::filesystem::path> paths;
+    for(size_t ii = 0; ii < no_datasets; ++ii)
+    {
+        paths.push_back(root / ("ds" + std::to_string(ii) + ".mmappet"));
+        auto writer = schema.create_writer(paths.back());
+        for(size_t row = 0; row < no_rows; ++row)
+            writer.write_row(row, row, row * 0.5, row * 0.25f, row, row, row, row);
+    }
+
+    // Touch the last row of every column, so that deferred mappings are paid for too
+    auto touch = [](auto&& dataset) {
+        auto row = dataset[dataset.size() - 1];
+        return static_cast<double>(std::get<0>(row)) + std::get<2>(row) + std::get<7>(row);
+    };
+
+    std::cout << no_datasets << " datasets x 8 columns x " << no_rows << " rows, " << rounds << " rounds\n";
+
+    bench("OpenColumn per column", no_datasets, rounds, [&](size_t ii) {
+        auto a = OpenColumn<uint64_t>(paths[ii], "a");
+        auto b = OpenColumn<uint32_t>(paths[ii], "b");
+        auto c = OpenColumn<double>(paths[ii], "c");
+        auto d = OpenColumn<float>(paths[ii], "d");
+        auto e = OpenColumn<int64_t>(paths[ii], "e");
+        auto f = OpenColumn<int32_t>(paths[ii], "f");
+        auto g = OpenColumn<uint16_t>(paths[ii], "g");
+        auto h = OpenColumn<uint8_t>(paths[ii], "h");
+        return static_cast<double>(a[a.size() - 1]) + c[c.size() - 1] + h[h.size() - 1];
+    });
+
+    bench("OpenColumn, parsed schema", no_datasets, rounds, [&](size_t ii) {
+        SchemaColumns parsed = read_schema(paths[ii]);
+        auto a = OpenColumn<uint64_t>(paths[ii], parsed, "a");
+        auto b = OpenColumn<uint32_t>(paths[ii], parsed, "b");
+        auto c = OpenColumn<double>(paths[ii], parsed, "c");
+        auto d = OpenColumn<float>(paths[ii], parsed, "d");
+        auto e = OpenColumn<int64_t>(paths[ii], parsed, "e");
+        auto f = OpenColumn<int32_t>(paths[ii], parsed, "f");
+        auto g = OpenColumn<uint16_t>(paths[ii], parsed, "g");
+        auto h = OpenColumn<uint8_t>(paths[ii], parsed, "h");
+        return static_cast<double>(a[a.size() - 1]) + c[c.size() - 1] + h[h.size() - 1];
+    });
+
+    bench("OpenDataset", no_datasets, rounds, [&](size_t ii) {
+        return touch(OpenDataset<uint64_t, uint32_t, double, float, int64_t, int32_t, uint16_t, uint8_t>(
+            paths[ii], {"a", "b", "c", "d", "e", "f", "g", "h"}));
+    });
+
+    bench("Schema::open_dataset", no_datasets, rounds, [&](size_t ii) {
+        return touch(schema.open_dataset(paths[ii]));
+    });
+
+    std::vector<std::unique_ptr<DirectoryHandle>> dirs;
+    for(const auto& path : paths)
+        dirs.push_back(std::make_unique<DirectoryHandle>(path));
+    bench("Schema::open_dataset_at", no_datasets, rounds, [&](size_t ii) {
+        return touch(schema.open_dataset_at(dirs[ii]->get(), paths[ii]));
+    });
+
+    bench("MapMode::Lazy, touch all", no_datasets, rounds, [&](size_t ii) {
+        return touch(schema.open_dataset(paths[ii], true, MapMode::Lazy));
+    });
+
+    bench("MapMode::Lazy, touch one", no_datasets, rounds, [&](size_t ii) {
+        auto dataset = schema.open_dataset(paths[ii], true, MapMode::Lazy);
+        return static_cast<double>(dataset.get_column<0>()[dataset.size() - 1]);
+    });
+
+    bench("MapMode::Parallel", no_datasets, rounds, [&](size_t ii) {
+        return touch(schema.open_dataset(paths[ii], true, MapMode::Parallel));
+    });
+
+    dirs.clear();
+    std::filesystem::remove_all(root);
+}
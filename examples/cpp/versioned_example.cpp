@@ -0,0 +1,48 @@
+#include <iostream>
+#include <mmappet/mmappet.h>
+
+int main()
+{
+
+    // Define a schema for the versioned dataset
+    Schema<size_t, double> schema("Id", "Value");
+    std::filesystem::remove_all("./test_versioned.mmappet");
+
+    // Only one writer at a time: a second one blocks until this one is destroyed
+    auto writer = schema.open_versioned_writer("./test_versioned.mmappet");
+
+    // Every append writes a new segment and publishes a new generation
+    for(size_t batch = 0; batch < 3; ++batch)
+    {
+        std::vector<size_t> ids(4);
+        std::vector<double> values(4);
+        for(size_t i = 0; i < ids.size(); ++i)
+        {
+            ids[i] = batch * ids.size() + i;
+            values[i] = ids[i] * 0.5;
+        }
+        writer.append_rows(ids.size(), ids.data(), values.data());
+    }
+
+    // A snapshot sees the generation current when it was opened, and keeps it alive
+    auto snapshot = schema.open_snapshot("./test_versioned.mmappet");
+
+    // Edits go to a copy of the segment, so the snapshot still sees the old values
+    writer.edit_segment(1, [](Dataset<size_t, double>& segment) {
+        for(size_t i = 0; i < segment.size(); ++i)
+            segment.get_column<1>()[i] = -1.0;
+    });
+    writer.append_rows(1, std::vector<size_t>{12}.data(), std::vector<double>{6.0}.data());
+
+    auto latest = schema.open_snapshot("./test_versioned.mmappet");
+    std::cout << "Snapshot of generation " << snapshot.generation() << ": " << snapshot.size() << " rows in "
+              << snapshot.number_of_segments() << " segments\n";
+    std::cout << "Snapshot of generation " << latest.generation() << ": " << latest.size() << " rows in "
+              << latest.number_of_segments() << " segments\n";
+    for(size_t row = 0; row < latest.size(); ++row)
+    {
+        auto [old_id, old_value] = row < snapshot.size() ? snapshot[row] : std::make_tuple(size_t(0), 0.0);
+        auto [id, value] = latest[row];
+        std::cout << id << "\t" << old_value << " -> " << value << "\n";
+    }
+}
@@ -0,0 +1,19 @@
+import os
+from setuptools import Extension, setup
+
+# The native reader builds on the POSIX mmap code in mmappet.h; elsewhere mmappet falls
+# back to its pure Python implementation, as it does if the extension fails to build.
+ext_modules = []
+if os.name == "posix":
+    ext_modules.append(
+        Extension(
+            "mmappet._mmappet_native",
+            sources=["src/mmappet/cpp/native/mmappet_native.cpp"],
+            include_dirs=["src/mmappet/cpp"],
+            language="c++",
+            extra_compile_args=["-std=c++20", "-O2"],
+            optional=True,
+        )
+    )
+
+setup(ext_modules=ext_modules)
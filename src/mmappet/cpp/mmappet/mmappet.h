@@ -19,6 +19,19 @@
 #include <cerrno>
 #include <cassert>
 #include <span>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <system_error>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
 #ifdef MMAPPET_USE_UNIX_FILEOPS
 #include <sys/types.h>
 #endif
@@ -36,78 +49,507 @@ constexpr bool is_compatible_type()
            );
 }
 
+// Fixed-capacity, constexpr-friendly storage for the schema.txt type names
+struct TypeStr {
+    char chars[32] = {};
+    size_t length = 0;
+
+    constexpr std::string_view view() const noexcept
+    {
+        return std::string_view(chars, length);
+    }
+};
+
+template<typename T>
+constexpr TypeStr make_type_str()
+{
+    std::string_view name;
+    if constexpr (is_compatible_type<T, uint8_t>()) name = "uint8";
+    else if constexpr (is_compatible_type<T, int8_t>()) name = "int8";
+    else if constexpr (is_compatible_type<T, uint16_t>()) name = "uint16";
+    else if constexpr (is_compatible_type<T, int16_t>()) name = "int16";
+    else if constexpr (is_compatible_type<T, uint32_t>()) name = "uint32";
+    else if constexpr (is_compatible_type<T, int32_t>()) name = "int32";
+    else if constexpr (is_compatible_type<T, uint64_t>()) name = "uint64";
+    else if constexpr (is_compatible_type<T, int64_t>()) name = "int64";
+    else if constexpr (is_compatible_type<T, float>()) name = "float32";
+    else if constexpr (is_compatible_type<T, double>()) name = "float64";
+    else name = "bytes";
+
+    TypeStr result;
+    for(char c : name)
+        result.chars[result.length++] = c;
+
+    if(name == "bytes")
+    {
+        char digits[20] = {};
+        size_t no_digits = 0;
+        size_t n = sizeof(T);
+        do {
+            digits[no_digits++] = static_cast<char>('0' + n % 10);
+            n /= 10;
+        } while(n > 0);
+        while(no_digits > 0)
+            result.chars[result.length++] = digits[--no_digits];
+    }
+    return result;
+}
+
+template<typename T>
+inline constexpr TypeStr type_str_storage = make_type_str<std::decay_t<T>>();
+
+// Type name of T as written in schema.txt, computed at compile time
+template<typename T>
+inline constexpr std::string_view type_str_v = type_str_storage<T>.view();
+
 template<typename T>
 #if defined(__cpp_lib_constexpr_string) && __cpp_lib_constexpr_string >= 201907L
 constexpr
 #endif
 std::string get_type_str()
 {
-    if constexpr (is_compatible_type<T, uint8_t>()) return "uint8";
-    else if constexpr (is_compatible_type<T, int8_t>()) return "int8";
-    else if constexpr (is_compatible_type<T, uint16_t>()) return "uint16";
-    else if constexpr (is_compatible_type<T, int16_t>()) return "int16";
-    else if constexpr (is_compatible_type<T, uint32_t>()) return "uint32";
-    else if constexpr (is_compatible_type<T, int32_t>()) return "int32";
-    else if constexpr (is_compatible_type<T, uint64_t>()) return "uint64";
-    else if constexpr (is_compatible_type<T, int64_t>()) return "int64";
-    else if constexpr (is_compatible_type<T, float>()) return "float32";
-    else if constexpr (is_compatible_type<T, double>()) return "float64";
-    else return "bytes" + std::to_string(sizeof(T));
+    return std::string(type_str_v<T>);
+}
+
+
+enum class MapMode : unsigned {
+    Default  = 0,
+    // stat columns on open, open() and mmap() each one on first access. Safe when several threads touch a
+    // column first at the same time: one maps it, the others wait. Columns are reopened by path on first access,
+    // also when the dataset was opened with open_dataset_at().
+    Lazy     = 1u << 0,
+    // open() and mmap() all columns concurrently on open (Lazy takes precedence). Only pays off for large
+    // or cold columns (and AnonHugePages copies), so datasets below MMAPPET_PARALLEL_MAP_MIN_BYTES map serially.
+    Parallel = 1u << 1,
+    // Ask for transparent huge pages on the file mapping (2 MiB aligned, MADV_HUGEPAGE). Only takes
+    // effect where the filesystem supports it, e.g. tmpfs mounted with huge=, and is ignored otherwise.
+    HugePages = 1u << 2,
+    // Copy the column into private anonymous memory backed by hugetlbfs pages (MAP_HUGETLB), falling back
+    // to transparent huge pages when none are reserved. Read-only: opening a column writable in this mode throws.
+    AnonHugePages = 1u << 3,
+};
+
+constexpr MapMode operator|(MapMode a, MapMode b) noexcept
+{
+    return static_cast<MapMode>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+}
+
+constexpr bool has_mode(MapMode mode, MapMode flag) noexcept
+{
+    return (static_cast<unsigned>(mode) & static_cast<unsigned>(flag)) != 0;
+}
+
+enum class GatherMode : unsigned {
+    Default  = 0,       // read rows in request order, with software prefetches ahead of each read
+    Bucketed = 1u << 0, // read rows grouped by position (counting sort on the high bits), for page and cache locality
+    WillNeed = 1u << 1, // madvise(MADV_WILLNEED) all pages to be read first, so I/O for cold columns starts early
+    Parallel = 1u << 2, // split large batches over threads
+};
+
+constexpr GatherMode operator|(GatherMode a, GatherMode b) noexcept
+{
+    return static_cast<GatherMode>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+}
+
+constexpr bool has_mode(GatherMode mode, GatherMode flag) noexcept
+{
+    return (static_cast<unsigned>(mode) & static_cast<unsigned>(flag)) != 0;
+}
+
+// Throws the failure of an operation on filepath with the errno value error. As a filesystem_error
+// (a std::system_error) it keeps the error code, so callers can tell e.g. a missing file from a denied one.
+[[noreturn]] static inline void throw_file_error(const std::string& what, const std::filesystem::path& filepath, int error = errno)
+{
+    throw std::filesystem::filesystem_error(what, filepath, std::error_code(error, std::generic_category()));
+}
+
+#ifndef MMAPPET_HUGE_PAGE_SIZE
+#define MMAPPET_HUGE_PAGE_SIZE (size_t(2) << 20)
+#endif
+
+// Maps length bytes of fd (or anonymous memory if fd == -1) at a MMAPPET_HUGE_PAGE_SIZE aligned address,
+// which the kernel needs to back the mapping with huge pages. Returns MAP_FAILED on error, with errno set.
+static inline void* mmap_huge_aligned(size_t length, int prot, int flags, int fd)
+{
+    const size_t huge_page_size = MMAPPET_HUGE_PAGE_SIZE;
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t reserved_length = length + huge_page_size;
+    void* reserved = mmap(nullptr, reserved_length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED)
+        return MAP_FAILED;
+
+    const uintptr_t reserved_start = reinterpret_cast<uintptr_t>(reserved);
+    const uintptr_t start = (reserved_start + huge_page_size - 1) & ~(huge_page_size - 1);
+    void* raw = mmap(reinterpret_cast<void*>(start), length, prot, flags | MAP_FIXED, fd, 0);
+    if (raw == MAP_FAILED)
+    {
+        int saved_errno = errno;
+        munmap(reserved, reserved_length);
+        errno = saved_errno;
+        return MAP_FAILED;
+    }
+
+    // Give back the unused head and tail of the reservation
+    const uintptr_t end = start + ((length + page_size - 1) & ~(page_size - 1));
+    const uintptr_t reserved_end = reserved_start + reserved_length;
+    if (start > reserved_start)
+        munmap(reserved, start - reserved_start);
+    if (reserved_end > end)
+        munmap(reinterpret_cast<void*>(end), reserved_end - end);
+#ifdef MADV_HUGEPAGE
+    madvise(raw, length, MADV_HUGEPAGE); // Best effort: fails where THP is compiled out
+#endif
+    return raw;
+}
+
+
+// Calls f(i) for every i in [0, n), spread over up to max_threads threads (0: hardware concurrency).
+// The calling thread takes part; the first exception thrown by any call is rethrown.
+template<typename F>
+void parallel_for(size_t n, F&& f, size_t max_threads = 0)
+{
+    if(max_threads == 0)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t no_threads = std::min(n, max_threads);
+    if(no_threads <= 1)
+    {
+        for(size_t ii = 0; ii < n; ++ii)
+            f(ii);
+        return;
+    }
+
+    std::atomic<size_t> next_index{0};
+    std::vector<std::exception_ptr> errors(no_threads);
+    auto worker = [&](size_t thread_nr) {
+        try {
+            for(size_t ii = next_index++; ii < n; ii = next_index++)
+                f(ii);
+        } catch(...) {
+            errors[thread_nr] = std::current_exception();
+            next_index = n;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(no_threads - 1);
+    for(size_t thread_nr = 1; thread_nr < no_threads; ++thread_nr)
+        threads.emplace_back(worker, thread_nr);
+    worker(0);
+    for(auto& thread : threads)
+        thread.join();
+
+    for(auto& error : errors)
+        if(error)
+            std::rethrow_exception(error);
+}
+
+
+// Smallest dataset (bytes over all columns) for which MapMode::Parallel spawns threads: below it,
+// starting threads costs more than the open() and mmap() calls they would overlap
+#ifndef MMAPPET_PARALLEL_MAP_MIN_BYTES
+#define MMAPPET_PARALLEL_MAP_MIN_BYTES (size_t(64) << 20)
+#endif
+
+#ifndef MMAPPET_PREFETCH_DISTANCE
+#define MMAPPET_PREFETCH_DISTANCE 16
+#endif
+
+// Smallest batch for which GatherMode::Parallel actually spawns threads, and the work unit per thread
+#ifndef MMAPPET_PARALLEL_GATHER_CHUNK
+#define MMAPPET_PARALLEL_GATHER_CHUNK (size_t(1) << 16)
+#endif
+
+// Counting sort setup shared by bucket_order and sorted_unique_ids. Buckets n ids (all below id_limit) by their
+// high bits: id goes to bucket id >> shift. Returns shift and the first slot of every bucket, followed by n.
+static inline std::pair<size_t, std::vector<size_t>> count_id_buckets(const size_t* ids, size_t n, size_t id_limit)
+{
+    size_t no_buckets = 1;
+    while (no_buckets < n / 8 && no_buckets < (size_t(1) << 16))
+        no_buckets <<= 1;
+    size_t shift = 0;
+    while (((id_limit - 1) >> shift) >= no_buckets)
+        ++shift;
+
+    std::vector<size_t> bucket_start(no_buckets + 1, 0);
+    for (size_t ii = 0; ii < n; ++ii)
+        ++bucket_start[(ids[ii] >> shift) + 1];
+    for (size_t bucket = 0; bucket < no_buckets; ++bucket)
+        bucket_start[bucket + 1] += bucket_start[bucket];
+    return {shift, std::move(bucket_start)};
+}
+
+// Permutation of [0, n) that visits ids (all below id_limit) bucketed by their high bits, so that
+// ids close to each other are visited together. Counting sort: O(n) regardless of the id range.
+static inline std::vector<size_t> bucket_order(const size_t* ids, size_t n, size_t id_limit)
+{
+    if (n == 0)
+        return {};
+    auto [shift, next_slot] = count_id_buckets(ids, n, id_limit);
+    std::vector<size_t> order(n);
+    for (size_t ii = 0; ii < n; ++ii)
+        order[next_slot[ids[ii] >> shift]++] = ii;
+    return order;
+}
+
+// The distinct values of ids (all below id_limit) in ascending order: the counting sort of bucket_order, then
+// a sort within each (on average small) bucket, so close to O(n). Visiting rows or groups in this order
+// touches pages in address order, which lets WillNeedAdvisor coalesce them into few madvise() calls.
+static inline std::vector<size_t> sorted_unique_ids(const size_t* ids, size_t n, size_t id_limit)
+{
+    if (n == 0)
+        return {};
+    const auto [shift, bucket_start] = count_id_buckets(ids, n, id_limit);
+    std::vector<size_t> next_slot(bucket_start.begin(), bucket_start.end() - 1);
+    std::vector<size_t> sorted(n);
+    for (size_t ii = 0; ii < n; ++ii)
+        sorted[next_slot[ids[ii] >> shift]++] = ids[ii];
+    for (size_t bucket = 0; bucket + 1 < bucket_start.size(); ++bucket)
+        std::sort(sorted.begin() + bucket_start[bucket], sorted.begin() + bucket_start[bucket + 1]);
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    return sorted;
+}
+
+// Coalesces byte ranges about to be read into page runs and madvise(MADV_WILLNEED)s each run.
+// Ranges must come in ascending address order (see sorted_unique_ids), or every range starts a new run.
+class WillNeedAdvisor {
+    const uintptr_t page_mask = ~(static_cast<uintptr_t>(sysconf(_SC_PAGESIZE)) - 1);
+    uintptr_t run_start = 0;
+    uintptr_t run_end = 0;
+public:
+    void add(const void* data, size_t bytes) noexcept
+    {
+        const uintptr_t start = reinterpret_cast<uintptr_t>(data) & page_mask;
+        const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes + ~page_mask) & page_mask;
+        if (start >= run_start && start <= run_end)
+        {
+            run_end = std::max(run_end, end);
+            return;
+        }
+        flush();
+        run_start = start;
+        run_end = end;
+    }
+
+    void flush() noexcept
+    {
+        if (run_end > run_start)
+            madvise(reinterpret_cast<void*>(run_start), run_end - run_start, MADV_WILLNEED);
+        run_start = run_end = 0;
+    }
+
+    ~WillNeedAdvisor() noexcept
+    {
+        flush();
+    }
+};
+
+// out[pos] = column[rows[pos]] for the positions order[begin, end), or [begin, end) if order is null
+template<typename U>
+void gather_column(const U* column, const size_t* rows, const size_t* order, size_t begin, size_t end, U* out)
+{
+    constexpr size_t distance = MMAPPET_PREFETCH_DISTANCE;
+    if (order == nullptr)
+    {
+        for (size_t ii = begin; ii < end; ++ii)
+        {
+            if (ii + distance < end)
+                __builtin_prefetch(column + rows[ii + distance]);
+            out[ii] = column[rows[ii]];
+        }
+        return;
+    }
+    for (size_t ii = begin; ii < end; ++ii)
+    {
+        if (ii + distance < end)
+            __builtin_prefetch(column + rows[order[ii + distance]]);
+        const size_t pos = order[ii];
+        out[pos] = column[rows[pos]];
+    }
+}
+
+// gather_column over items of itemsize bytes; 1, 2, 4 and 8 byte items are copied as integers
+static inline void gather_column_raw(const std::byte* column, size_t itemsize, const size_t* rows, const size_t* order, size_t begin, size_t end, std::byte* out)
+{
+    switch (itemsize)
+    {
+    case 1: return gather_column(reinterpret_cast<const uint8_t*>(column), rows, order, begin, end, reinterpret_cast<uint8_t*>(out));
+    case 2: return gather_column(reinterpret_cast<const uint16_t*>(column), rows, order, begin, end, reinterpret_cast<uint16_t*>(out));
+    case 4: return gather_column(reinterpret_cast<const uint32_t*>(column), rows, order, begin, end, reinterpret_cast<uint32_t*>(out));
+    case 8: return gather_column(reinterpret_cast<const uint64_t*>(column), rows, order, begin, end, reinterpret_cast<uint64_t*>(out));
+    }
+    constexpr size_t distance = MMAPPET_PREFETCH_DISTANCE;
+    for (size_t ii = begin; ii < end; ++ii)
+    {
+        if (ii + distance < end)
+            __builtin_prefetch(column + rows[order ? order[ii + distance] : ii + distance] * itemsize);
+        const size_t pos = order ? order[ii] : ii;
+        std::memcpy(out + pos * itemsize, column + rows[pos] * itemsize, itemsize);
+    }
+}
+
+// Row gather behind Dataset::gather_into, over columns given as raw bytes (so also usable where the schema is
+// only known at runtime): columns[c] holds no_rows items of itemsizes[c] bytes, and outs[c][i] receives item
+// rows[i] of it. The columns must already be mapped.
+static inline void gather_rows_raw(std::span<const std::byte* const> columns, std::span<const size_t> itemsizes, size_t no_rows,
+                                   std::span<const size_t> rows, std::span<std::byte* const> outs, GatherMode mode)
+{
+    const size_t n = rows.size();
+    for (size_t row : rows)
+        if (row >= no_rows)
+            throw std::out_of_range("Row index out of range in Dataset::gather");
+
+    std::vector<size_t> order;
+    if (has_mode(mode, GatherMode::Bucketed))
+        order = bucket_order(rows.data(), n, no_rows);
+    const size_t* order_ptr = order.empty() ? nullptr : order.data();
+
+    if (has_mode(mode, GatherMode::WillNeed))
+    {
+        const std::vector<size_t> sorted_rows = sorted_unique_ids(rows.data(), n, no_rows);
+        for (size_t col_nr = 0; col_nr < columns.size(); ++col_nr)
+        {
+            WillNeedAdvisor advisor;
+            for (size_t row : sorted_rows)
+                advisor.add(columns[col_nr] + row * itemsizes[col_nr], itemsizes[col_nr]);
+        }
+    }
+
+    auto gather_range = [&](size_t begin, size_t end) {
+        for (size_t col_nr = 0; col_nr < columns.size(); ++col_nr)
+            gather_column_raw(columns[col_nr], itemsizes[col_nr], rows.data(), order_ptr, begin, end, outs[col_nr]);
+    };
+    if (has_mode(mode, GatherMode::Parallel) && n >= 2 * MMAPPET_PARALLEL_GATHER_CHUNK)
+    {
+        const size_t no_chunks = (n + MMAPPET_PARALLEL_GATHER_CHUNK - 1) / MMAPPET_PARALLEL_GATHER_CHUNK;
+        parallel_for(no_chunks, [&](size_t chunk) {
+            const size_t begin = chunk * MMAPPET_PARALLEL_GATHER_CHUNK;
+            gather_range(begin, std::min(n, begin + MMAPPET_PARALLEL_GATHER_CHUNK));
+        });
+    }
+    else
+        gather_range(0, n);
+}
+
+// Start of every requested group in the gathered output, plus the total row count: group group_ids[i]
+// goes to rows [offsets[i], offsets[i + 1]). index holds no_groups + 1 group boundaries into no_rows rows;
+// only the boundaries of the requested groups are checked, so the cost is independent of the index size.
+static inline std::vector<size_t> gathered_group_offsets(const size_t* index, size_t no_groups, size_t no_rows, std::span<const size_t> group_ids)
+{
+    std::vector<size_t> offsets(group_ids.size() + 1, 0);
+    for (size_t ii = 0; ii < group_ids.size(); ++ii)
+    {
+        const size_t group = group_ids[ii];
+        if (group >= no_groups)
+            throw std::out_of_range("Group index out of range in IndexedDataset::gather_groups");
+        if (index[group] > index[group + 1] || index[group + 1] > no_rows)
+            throw std::runtime_error("Corrupted index: boundaries of group " + std::to_string(group) + " are decreasing or exceed the dataset");
+        offsets[ii + 1] = offsets[ii] + index[group + 1] - index[group];
+    }
+    return offsets;
+}
+
+// Group gather behind IndexedDataset::gather_groups, over raw columns as in gather_rows_raw. offsets comes
+// from gathered_group_offsets(), and outs[c] has room for offsets.back() items.
+static inline void gather_groups_raw(std::span<const std::byte* const> columns, std::span<const size_t> itemsizes,
+                                     const size_t* index, size_t no_groups, std::span<const size_t> group_ids,
+                                     const std::vector<size_t>& offsets, std::span<std::byte* const> outs, GatherMode mode)
+{
+    const size_t n = group_ids.size();
+    std::vector<size_t> order;
+    if (has_mode(mode, GatherMode::Bucketed))
+        order = bucket_order(group_ids.data(), n, no_groups);
+    const size_t* order_ptr = order.empty() ? nullptr : order.data();
+
+    if (has_mode(mode, GatherMode::WillNeed))
+    {
+        const std::vector<size_t> sorted_groups = sorted_unique_ids(group_ids.data(), n, no_groups);
+        for (size_t col_nr = 0; col_nr < columns.size(); ++col_nr)
+        {
+            WillNeedAdvisor advisor;
+            for (size_t group : sorted_groups)
+                advisor.add(columns[col_nr] + index[group] * itemsizes[col_nr], (index[group + 1] - index[group]) * itemsizes[col_nr]);
+        }
+    }
+
+    auto gather_range = [&](size_t begin, size_t end) {
+        constexpr size_t distance = MMAPPET_PREFETCH_DISTANCE;
+        for (size_t col_nr = 0; col_nr < columns.size(); ++col_nr)
+        {
+            const std::byte* column = columns[col_nr];
+            const size_t itemsize = itemsizes[col_nr];
+            for (size_t ii = begin; ii < end; ++ii)
+            {
+                if (ii + distance < end)
+                    __builtin_prefetch(column + index[group_ids[order_ptr ? order_ptr[ii + distance] : ii + distance]] * itemsize);
+                const size_t pos = order_ptr ? order_ptr[ii] : ii;
+                std::memcpy(outs[col_nr] + offsets[pos] * itemsize, column + index[group_ids[pos]] * itemsize, (offsets[pos + 1] - offsets[pos]) * itemsize);
+            }
+        }
+    };
+    if (has_mode(mode, GatherMode::Parallel) && offsets[n] >= 2 * MMAPPET_PARALLEL_GATHER_CHUNK && n > 1)
+    {
+        // Chunks of groups holding roughly MMAPPET_PARALLEL_GATHER_CHUNK rows each
+        const size_t no_chunks = std::min(n, offsets[n] / MMAPPET_PARALLEL_GATHER_CHUNK);
+        parallel_for(no_chunks, [&](size_t chunk) {
+            gather_range(chunk * n / no_chunks, (chunk + 1) * n / no_chunks);
+        });
+    }
+    else
+        gather_range(0, n);
 }
 
 template<typename T>
 class MMappedData {
-    T* mappedData = nullptr;
-    int fileDescriptor = -1;
+    mutable T* mappedData = nullptr;
+    mutable int fileDescriptor = -1;
     size_t dataSize = 0;
     size_t no_elements = 0;
     const std::filesystem::path filepath;
     int open_flags;
     int mmap_prot;
     int mmap_flags;
+    MapMode mode;
+    mutable size_t mapLength = 0;
+    // Pending while a column deferred by MapMode::Lazy or Parallel is unmapped, Mapping while one thread maps it
+    enum class MapState : unsigned char { Mapped, Pending, Mapping };
+    mutable std::atomic<MapState> map_state{MapState::Mapped};
+    mutable bool hugetlb_backed = false;
 
 public:
-    MMappedData(const std::filesystem::path& filepath, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED) :
+    MMappedData(const std::filesystem::path& filepath, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED, MapMode mode = MapMode::Default) :
         filepath(filepath),
         open_flags(open_flags),
         mmap_prot(mmap_prot),
-        mmap_flags(mmap_flags)
+        mmap_flags(mmap_flags),
+        mode(mode)
     {
-        open_and_map(open_flags, mmap_prot, mmap_flags);
+        check_mode();
+        open_or_defer(AT_FDCWD, this->filepath.c_str());
     }
 
-    void open_and_map(int open_flags, int mmap_prot, int mmap_flags)
+    // Opens `filename` relative to dirfd, an open file descriptor of the directory `dirpath`.
+    // dirpath is still needed for error messages, lazy mapping and resize().
+    MMappedData(int dirfd, const std::filesystem::path& dirpath, const std::string& filename, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED, MapMode mode = MapMode::Default) :
+        filepath(dirpath / filename),
+        open_flags(open_flags),
+        mmap_prot(mmap_prot),
+        mmap_flags(mmap_flags),
+        mode(mode)
     {
-        dataSize = std::filesystem::file_size(filepath);
-        if(dataSize % sizeof(T) != 0)
-            throw std::runtime_error("File size is not a multiple of element size for file: " + filepath.string());
-        no_elements = dataSize / sizeof(T);
-
-        fileDescriptor = open(filepath.c_str(), open_flags);
-        if (fileDescriptor == -1)
-            throw std::runtime_error("Failed to open file: " + filepath.string() + ", error: " + std::strerror(errno));
-
-        if (no_elements == 0) {
-            // Empty dataset, avoid mmap call, which would fail
-            mappedData = nullptr;
-            return;
-        }
+        check_mode();
+        open_or_defer(dirfd, dirfd == AT_FDCWD ? this->filepath.c_str() : filename.c_str());
+    }
 
-        void* raw = mmap(nullptr, dataSize, mmap_prot, mmap_flags, fileDescriptor, 0);
-        if (raw == MAP_FAILED)
-        {
-            close(fileDescriptor);
-            fileDescriptor = -1;
-            throw std::runtime_error("Failed to mmap file: " + filepath.string() + ", error: " + std::strerror(errno));
-        }
-        mappedData = static_cast<T*>(raw);
+    void open_and_map(int open_flags, int mmap_prot, int mmap_flags)
+    {
+        open_and_map_at(AT_FDCWD, filepath.c_str(), open_flags, mmap_prot, mmap_flags);
     }
 
     void close_and_unmap() noexcept
     {
         if (mappedData)
         {
-            munmap(mappedData, dataSize);
+            munmap(mappedData, mapLength);
             mappedData = nullptr;
         }
         if (fileDescriptor != -1)
@@ -115,16 +557,26 @@ public:
             close(fileDescriptor);
             fileDescriptor = -1;
         }
+        map_state.store(MapState::Mapped, std::memory_order_relaxed);
     }
 
     void resize(size_t new_no_elements)
     {
+        if (has_mode(mode, MapMode::AnonHugePages))
+            throw std::runtime_error("Cannot resize a column loaded into anonymous memory: " + filepath.string());
         close_and_unmap();
         dataSize = new_no_elements * sizeof(T);
         std::filesystem::resize_file(filepath, dataSize);
         open_and_map(open_flags, mmap_prot, mmap_flags);
     }
 
+    // Maps a column opened with MapMode::Lazy or MapMode::Parallel, no-op otherwise
+    void ensure_mapped() const
+    {
+        if (map_state.load(std::memory_order_acquire) != MapState::Mapped)
+            map_deferred();
+    }
+
     ~MMappedData() noexcept
     {
         close_and_unmap();
@@ -136,34 +588,225 @@ public:
         mappedData(other.mappedData),
         fileDescriptor(other.fileDescriptor),
         dataSize(other.dataSize),
-        no_elements(other.no_elements)
+        no_elements(other.no_elements),
+        filepath(other.filepath),
+        open_flags(other.open_flags),
+        mmap_prot(other.mmap_prot),
+        mmap_flags(other.mmap_flags),
+        mode(other.mode),
+        mapLength(other.mapLength),
+        map_state(other.map_state.load(std::memory_order_acquire)),
+        hugetlb_backed(other.hugetlb_backed)
     {
         other.mappedData = nullptr;
         other.fileDescriptor = -1;
         other.dataSize = 0;
         other.no_elements = 0;
+        other.mapLength = 0;
+        other.map_state.store(MapState::Mapped, std::memory_order_relaxed);
     }
     MMappedData& operator=(MMappedData&&) noexcept = delete;
 
     inline T& operator[](size_t index) const {
 
-        return mappedData[index];
+        return data()[index];
     }
 
     inline size_t size() const noexcept {
         return no_elements;
     }
 
-    inline T* data() const noexcept {
+    inline T* data() const {
+        if (map_state.load(std::memory_order_acquire) != MapState::Mapped) [[unlikely]]
+            map_deferred();
         return mappedData;
     }
+
+    // True if the column was loaded with MapMode::AnonHugePages and got hugetlbfs pages, not the THP fallback
+    bool is_hugetlb_backed() const noexcept {
+        return hugetlb_backed;
+    }
+
+private:
+    // Writes to an anonymous copy would be silently lost, so refuse them up front
+    void check_mode() const
+    {
+        if (has_mode(mode, MapMode::AnonHugePages) && ((mmap_prot & PROT_WRITE) || (open_flags & O_ACCMODE) != O_RDONLY))
+            throw std::invalid_argument("MapMode::AnonHugePages columns are read-only, cannot open writable: " + filepath.string());
+    }
+
+    void set_size(size_t new_data_size)
+    {
+        if(new_data_size % sizeof(T) != 0)
+            throw std::runtime_error("File size is not a multiple of element size for file: " + filepath.string());
+        dataSize = new_data_size;
+        no_elements = dataSize / sizeof(T);
+    }
+
+    void open_or_defer(int dirfd, const char* name)
+    {
+        if (!has_mode(mode, MapMode::Lazy) && !has_mode(mode, MapMode::Parallel))
+        {
+            open_and_map_at(dirfd, name, open_flags, mmap_prot, mmap_flags);
+            return;
+        }
+        // Only the size is needed up front: the owning Dataset checks column lengths against each other
+        struct stat st;
+        if (fstatat(dirfd, name, &st, 0) == -1)
+            throw_file_error("Failed to stat file", filepath);
+        // st_size is the data size of regular files only; fail others as opening or mapping them would
+        if (!S_ISREG(st.st_mode))
+            throw_file_error("Failed to open file", filepath, S_ISDIR(st.st_mode) && (open_flags & O_ACCMODE) != O_RDONLY ? EISDIR : ENODEV);
+        set_size(st.st_size);
+        map_state.store(no_elements > 0 ? MapState::Pending : MapState::Mapped, std::memory_order_relaxed);
+    }
+
+    void open_and_map_at(int dirfd, const char* name, int open_flags, int mmap_prot, int mmap_flags)
+    {
+        fileDescriptor = openat(dirfd, name, open_flags);
+        if (fileDescriptor == -1)
+            throw_file_error("Failed to open file", filepath);
+
+        struct stat st;
+        try {
+            if (fstat(fileDescriptor, &st) == -1)
+                throw_file_error("Failed to stat file", filepath);
+            set_size(st.st_size);
+        } catch (...) {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+            throw;
+        }
+
+        if (no_elements == 0) {
+            // Empty dataset, avoid mmap call, which would fail
+            mappedData = nullptr;
+            return;
+        }
+
+        void* raw = map_fd(fileDescriptor, mmap_prot, mmap_flags);
+        if (raw == MAP_FAILED || has_mode(mode, MapMode::AnonHugePages))
+        {
+            int saved_errno = errno;
+            close(fileDescriptor);
+            fileDescriptor = -1;
+            if (raw == MAP_FAILED)
+                throw_file_error("Failed to mmap file", filepath, saved_errno);
+        }
+        mappedData = static_cast<T*>(raw);
+    }
+
+    // The first thread to get here maps the column, threads arriving meanwhile wait for it. If mapping
+    // fails the column stays pending, and the next access tries again.
+    void map_deferred() const
+    {
+        MapState state = MapState::Pending;
+        while (!map_state.compare_exchange_weak(state, MapState::Mapping, std::memory_order_acquire))
+        {
+            if (state == MapState::Mapped)
+                return;
+            if (state == MapState::Mapping)
+                map_state.wait(MapState::Mapping, std::memory_order_acquire);
+            state = MapState::Pending;
+        }
+        try {
+            map_now();
+        } catch (...) {
+            map_state.store(MapState::Pending, std::memory_order_release);
+            map_state.notify_all();
+            throw;
+        }
+        map_state.store(MapState::Mapped, std::memory_order_release);
+        map_state.notify_all();
+    }
+
+    void map_now() const
+    {
+        int fd = open(filepath.c_str(), open_flags);
+        if (fd == -1)
+            throw_file_error("Failed to open file", filepath);
+
+        // Mapping past the end of a file that shrank since it was stat()ed would SIGBUS on access
+        struct stat st;
+        if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < dataSize)
+        {
+            close(fd);
+            throw std::runtime_error("File changed size since the dataset was opened: " + filepath.string());
+        }
+
+        void* raw = map_fd(fd, mmap_prot, mmap_flags);
+        if (raw == MAP_FAILED || has_mode(mode, MapMode::AnonHugePages))
+        {
+            int saved_errno = errno;
+            close(fd);
+            fd = -1;
+            if (raw == MAP_FAILED)
+                throw_file_error("Failed to mmap file", filepath, saved_errno);
+        }
+        fileDescriptor = fd;
+        mappedData = static_cast<T*>(raw);
+    }
+
+    // Maps dataSize bytes of fd as requested by mode. Returns MAP_FAILED on error, with errno set.
+    void* map_fd(int fd, int mmap_prot, int mmap_flags) const
+    {
+        if (has_mode(mode, MapMode::AnonHugePages))
+            return load_anonymous(fd, mmap_prot);
+
+        mapLength = dataSize;
+        if (has_mode(mode, MapMode::HugePages) && dataSize >= MMAPPET_HUGE_PAGE_SIZE)
+            return mmap_huge_aligned(dataSize, mmap_prot, mmap_flags, fd);
+        return mmap(nullptr, dataSize, mmap_prot, mmap_flags, fd, 0);
+    }
+
+    void* load_anonymous(int fd, int mmap_prot) const
+    {
+        const size_t length = (dataSize + MMAPPET_HUGE_PAGE_SIZE - 1) & ~(MMAPPET_HUGE_PAGE_SIZE - 1);
+        void* raw = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        int hugetlb_flags = MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+        hugetlb_flags |= __builtin_ctzll(MMAPPET_HUGE_PAGE_SIZE) << MAP_HUGE_SHIFT;
+#endif
+        raw = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | hugetlb_flags, -1, 0);
+#endif
+        hugetlb_backed = raw != MAP_FAILED;
+        if (!hugetlb_backed)
+            // No hugetlbfs pages reserved (vm.nr_hugepages): settle for transparent huge pages
+            raw = mmap_huge_aligned(length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+        if (raw == MAP_FAILED)
+            return MAP_FAILED;
+
+        char* dest = static_cast<char*>(raw);
+        size_t bytes_read = 0;
+        while (bytes_read < dataSize)
+        {
+            ssize_t result = pread(fd, dest + bytes_read, dataSize - bytes_read, bytes_read);
+            if (result == -1 && errno == EINTR)
+                continue;
+            if (result <= 0)
+            {
+                int saved_errno = result == 0 ? EIO : errno;
+                munmap(raw, length);
+                errno = saved_errno;
+                return MAP_FAILED;
+            }
+            bytes_read += result;
+        }
+        mprotect(raw, length, mmap_prot);
+        mapLength = length;
+        return raw;
+    }
 };
 
 
+// (type string, column name) pairs, in the order listed in schema.txt
+using SchemaColumns = std::vector<std::pair<std::string, std::string>>;
+
 template<typename... Args>
 class Dataset {
 public:
-    Dataset(const std::filesystem::path&, std::vector<std::pair<std::string,std::string>>, size_t, int, int, int)
+    Dataset(const std::filesystem::path&, const SchemaColumns&, size_t, int, int, int, int = AT_FDCWD, MapMode = MapMode::Default)
     {
         // Base case: do nothing
     }
@@ -182,57 +825,162 @@ public:
     {
         // Base case: do nothing
     }
+
+    size_t byte_size() const noexcept
+    {
+        return 0;
+    }
+
+    template<typename F>
+    void for_each_column(F&&)
+    {
+        // Base case: do nothing
+    }
 };
 
-static inline std::pair<std::string, std::string>
-split_first_space(const std::string& s) {
-    size_t pos = s.find(' ');
-    if (pos == std::string::npos) {
-        return {s, ""};
+// Owns a directory file descriptor, so that the files inside can be opened with openat()
+class DirectoryHandle {
+    int fd = -1;
+public:
+    explicit DirectoryHandle(const std::filesystem::path& dirpath)
+    {
+        fd = open(dirpath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1)
+            throw_file_error("Failed to open directory", dirpath);
     }
-    return { s.substr(0, pos), s.substr(pos + 1) };
+
+    ~DirectoryHandle() noexcept
+    {
+        if (fd != -1)
+            close(fd);
+    }
+
+    DirectoryHandle(const DirectoryHandle&) = delete;
+    DirectoryHandle& operator=(const DirectoryHandle&) = delete;
+
+    int get() const noexcept
+    {
+        return fd;
+    }
+};
+
+// Reads the whole of an open file; filepath is only used for error messages
+static inline std::string read_fd_text(int fd, const std::filesystem::path& filepath)
+{
+    std::string text;
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+        text.resize(st.st_size);
+    size_t bytes_read = 0;
+    while (true)
+    {
+        if (bytes_read == text.size())
+            text.resize(text.size() + 256);
+        ssize_t result = pread(fd, text.data() + bytes_read, text.size() - bytes_read, bytes_read);
+        if (result == -1 && errno == EINTR)
+            continue;
+        if (result == -1)
+            throw_file_error("Failed to read file", filepath);
+        if (result == 0)
+            break;
+        bytes_read += result;
+    }
+    text.resize(bytes_read);
+    return text;
 }
 
+// Reads the file `name` in the directory dirpath in one go. If dirfd is given, it must be an open
+// file descriptor of dirpath, and the file is opened relative to it.
+static inline std::string read_text_file(const std::filesystem::path& dirpath, const char* name, int dirfd = AT_FDCWD)
+{
+    const std::filesystem::path filepath = dirpath / name;
+    int fd = openat(dirfd, dirfd == AT_FDCWD ? filepath.c_str() : name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        throw_file_error("Failed to open file", filepath);
+    try {
+        std::string text = read_fd_text(fd, filepath);
+        close(fd);
+        return text;
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
 
-template<typename T>
-MMappedData<T> OpenColumn(const std::filesystem::path& filepath, const std::string column_name, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED)
+static inline std::string read_schema_text(const std::filesystem::path& dirpath, int dirfd = AT_FDCWD)
 {
-    std::ifstream file;
-    file.open(filepath / "schema.txt", std::ios::in | std::ios::binary);
-    if(!file.is_open())
-        throw std::runtime_error("Failed to open schema file: " + (filepath / "schema.txt").string() + ", error: " + std::strerror(errno));
+    return read_text_file(dirpath, "schema.txt", dirfd);
+}
 
-    std::string s;
-    size_t col_nr = 0;
-    bool found = false;
-    while(std::getline(file, s))
+static inline SchemaColumns parse_schema_text(std::string_view text)
+{
+    SchemaColumns columns;
+    while (!text.empty())
     {
-        if(s.empty())
+        size_t eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+        if (line.empty())
             continue;
-        auto [type_str, col_name] = split_first_space(s);
-        if(col_name == column_name)
-        {
-            if(type_str != get_type_str<T>())
-                throw std::runtime_error("Type mismatch for column '" + column_name +
-                                         "': expected " + get_type_str<T>() +
-                                         ", got " + type_str);
-            found = true;
-            break;
-        }
-        ++col_nr;
+        size_t pos = line.find(' ');
+        if (pos == std::string_view::npos)
+            columns.emplace_back(line, "");
+        else
+            columns.emplace_back(line.substr(0, pos), line.substr(pos + 1));
+    }
+    return columns;
+}
+
+// Parses schema.txt once; pass the result to OpenColumn() to open several columns of one dataset
+static inline SchemaColumns read_schema(const std::filesystem::path& filepath, int dirfd = AT_FDCWD)
+{
+    return parse_schema_text(read_schema_text(filepath, dirfd));
+}
+
+template<typename Names>
+void check_column_names(const Names& column_names, const SchemaColumns& schema)
+{
+    if(std::size(column_names) != schema.size())
+        throw std::runtime_error("Number of column names provided as argument does not match number of columns in file.");
+
+    size_t ii = 0;
+    for(const std::string& name : column_names)
+    {
+        if(name != schema[ii].second)
+            throw std::runtime_error("Column name mismatch at column " + std::to_string(ii) +
+                                     ": expected '" + name +
+                                     "', got '" + schema[ii].second + "'");
+        ++ii;
     }
-    file.close();
+}
 
-    if(!found)
-        throw std::runtime_error("Column '" + column_name + "' not found in schema file: " + (filepath / "schema.txt").string());
 
-    return MMappedData<T>(filepath / (std::to_string(col_nr) + ".bin"), open_flags, mmap_prot, mmap_flags);
+template<typename T>
+MMappedData<T> OpenColumn(const std::filesystem::path& filepath, const SchemaColumns& schema, const std::string& column_name, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED, MapMode mode = MapMode::Default)
+{
+    for(size_t col_nr = 0; col_nr < schema.size(); ++col_nr)
+    {
+        const auto& [type_str, col_name] = schema[col_nr];
+        if(col_name != column_name)
+            continue;
+        if(type_str != type_str_v<T>)
+            throw std::runtime_error("Type mismatch for column '" + column_name +
+                                     "': expected " + get_type_str<T>() +
+                                     ", got " + type_str);
+        return MMappedData<T>(filepath / (std::to_string(col_nr) + ".bin"), open_flags, mmap_prot, mmap_flags, mode);
+    }
+    throw std::runtime_error("Column '" + column_name + "' not found in schema file: " + (filepath / "schema.txt").string());
+}
+
+template<typename T>
+MMappedData<T> OpenColumn(const std::filesystem::path& filepath, const std::string column_name, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED, MapMode mode = MapMode::Default)
+{
+    return OpenColumn<T>(filepath, read_schema(filepath), column_name, open_flags, mmap_prot, mmap_flags, mode);
 }
 
 template<typename T, typename... Args>
 class Dataset<T, Args...>
 {
-    const std::string type_str;
     const std::string column_name;
     const size_t column_number;
     MMappedData<T> data;
@@ -240,20 +988,23 @@ class Dataset<T, Args...>
 
 public:
 
+    // If dirfd is given, it must be an open file descriptor of filepath; columns are opened relative to it.
     Dataset(const std::filesystem::path& filepath,
-            const std::vector<std::pair<std::string, std::string>>& type_strs,
+            const SchemaColumns& type_strs,
             size_t col_nr,
             int open_flags = O_RDONLY,
             int mmap_prot = PROT_READ,
-            int mmap_flags = MAP_SHARED
+            int mmap_flags = MAP_SHARED,
+            int dirfd = AT_FDCWD,
+            MapMode mode = MapMode::Default
         ) :
-        type_str(type_strs[col_nr].first),
         column_name(type_strs[col_nr].second),
         column_number(col_nr),
-        data(filepath / (std::to_string(col_nr) + ".bin"), open_flags, mmap_prot, mmap_flags),
-        next_dataset(filepath, type_strs, col_nr + 1, open_flags, mmap_prot, mmap_flags)
+        data(dirfd, filepath, std::to_string(col_nr) + ".bin", open_flags, mmap_prot, mmap_flags, mode),
+        next_dataset(filepath, type_strs, col_nr + 1, open_flags, mmap_prot, mmap_flags, dirfd, mode)
     {
-        if(type_str != get_type_str<T>())
+        const std::string& type_str = type_strs[col_nr].first;
+        if(type_str != type_str_v<T>)
             throw std::runtime_error("Type mismatch for column " + std::to_string(column_number) +
                                      ": expected " + get_type_str<T>() +
                                      ", got " + type_str);
@@ -261,6 +1012,8 @@ public:
             if(next_dataset.size() != data.size())
                 throw std::runtime_error("Column size mismatch between column " + std::to_string(column_number) +
                                      " and column " + std::to_string(column_number + 1));
+        if(col_nr == 0 && has_mode(mode, MapMode::Parallel) && !has_mode(mode, MapMode::Lazy))
+            map_columns(byte_size() >= MMAPPET_PARALLEL_MAP_MIN_BYTES);
     }
 
     template <size_t colnr>
@@ -273,11 +1026,24 @@ public:
         }
     }
 
+    template<typename F>
+    void for_each_column(F&& f)
+    {
+        f(data);
+        next_dataset.for_each_column(f);
+    }
+
     inline size_t size() const noexcept
     {
         return data.size();
     }
 
+    // Total size of the columns in bytes
+    size_t byte_size() const noexcept
+    {
+        return data.size() * sizeof(T) + next_dataset.byte_size();
+    }
+
     void resize(size_t new_size)
     {
         data.resize(new_size);
@@ -294,6 +1060,34 @@ public:
         return std::tuple_cat(std::make_tuple(data[index]), next_dataset[index]);
     }
 
+    // Copies rows row_ids of every column into caller-provided buffers, one per column (structure of arrays),
+    // each with room for row_ids.size() elements. out[i] receives the value of row row_ids[i].
+    void gather_into(std::span<const size_t> row_ids, T* out, Args*... outs, GatherMode mode = GatherMode::Default)
+    {
+        const auto [columns, itemsizes] = raw_columns();
+        const std::array<std::byte*, sizeof...(Args) + 1> out_ptrs{reinterpret_cast<std::byte*>(out), reinterpret_cast<std::byte*>(outs)...};
+        gather_rows_raw(columns, itemsizes, size(), row_ids, out_ptrs, mode);
+    }
+
+    std::tuple<std::vector<T>, std::vector<Args>...> gather(std::span<const size_t> row_ids, GatherMode mode = GatherMode::Default)
+    {
+        std::tuple<std::vector<T>, std::vector<Args>...> result{std::vector<T>(row_ids.size()), std::vector<Args>(row_ids.size())...};
+        std::apply([&](auto&... columns) { gather_into(row_ids, columns.data()..., mode); }, result);
+        return result;
+    }
+
+    // Mapped data and item size of every column, as taken by gather_rows_raw and gather_groups_raw
+    std::pair<std::array<const std::byte*, sizeof...(Args) + 1>, std::array<size_t, sizeof...(Args) + 1>> raw_columns()
+    {
+        std::pair<std::array<const std::byte*, sizeof...(Args) + 1>, std::array<size_t, sizeof...(Args) + 1>> result;
+        size_t col_nr = 0;
+        for_each_column([&](const auto& column) {
+            result.first[col_nr] = reinterpret_cast<const std::byte*>(column.data());
+            result.second[col_nr++] = sizeof(*column.data());
+        });
+        return result;
+    }
+
     class Iterator {
         size_t index;
         Dataset<T, Args...>* dataset;
@@ -317,43 +1111,34 @@ public:
     Iterator end() {
         return Iterator(data.size(), this);
     }
-};
-
-
-template<typename T, typename... Args>
-auto OpenDataset(const std::filesystem::path& filepath, std::initializer_list<std::string> column_names, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED)
-{
-    std::ifstream file;
-    file.open(filepath / "schema.txt", std::ios::in | std::ios::binary);
-    if(!file.is_open())
-        throw std::runtime_error("Failed to open schema file: " + (filepath / "schema.txt").string() + ", error: " + std::strerror(errno));
 
-    std::vector<std::pair<std::string, std::string>> tmp_type_strs;
-    std::string s;
-    while(std::getline(file, s))
+private:
+    // Maps columns deferred by MapMode::Parallel, all of them concurrently if in_parallel
+    void map_columns(bool in_parallel)
     {
-        if(s.empty())
-            continue;
-        size_t pos = s.find(' ');
-        if (pos == std::string::npos)
-            tmp_type_strs.emplace_back(s, "");
-        else
-            tmp_type_strs.emplace_back(s.substr(0, pos), s.substr(pos + 1));
+        if(!in_parallel || sizeof...(Args) == 0)
+        {
+            for_each_column([](const auto& column) { column.ensure_mapped(); });
+            return;
+        }
+        parallel_for(sizeof...(Args) + 1, [this](size_t col_nr) {
+            size_t ii = 0;
+            for_each_column([&](const auto& column) {
+                if(ii++ == col_nr)
+                    column.ensure_mapped();
+            });
+        });
     }
-    file.close();
+};
 
-    if(column_names.size() != tmp_type_strs.size())
-        throw std::runtime_error("Number of column names provided as argument does not match number of columns in file.");
 
-    size_t ii = 0;
-    for(auto it = column_names.begin(); it != column_names.end(); ++it, ++ii)
-    {
-        if(*it != tmp_type_strs[ii].second)
-            throw std::runtime_error("Column name mismatch at column " + std::to_string(ii) +
-                                     ": expected '" + *it +
-                                     "', got '" + tmp_type_strs[ii].second + "'");
-    }
-    return Dataset<T, Args...>(filepath, tmp_type_strs, 0, open_flags, mmap_prot, mmap_flags);
+template<typename T, typename... Args>
+auto OpenDataset(const std::filesystem::path& filepath, std::initializer_list<std::string> column_names, int open_flags = O_RDONLY, int mmap_prot = PROT_READ, int mmap_flags = MAP_SHARED, MapMode mode = MapMode::Default)
+{
+    DirectoryHandle dir(filepath);
+    SchemaColumns schema = read_schema(filepath, dir.get());
+    check_column_names(column_names, schema);
+    return Dataset<T, Args...>(filepath, schema, 0, open_flags, mmap_prot, mmap_flags, dir.get(), mode);
 }
 
 
@@ -361,7 +1146,7 @@ auto OpenDataset(const std::filesystem::path& filepath, std::initializer_list<st
 template<size_t idx, typename T, typename... Args>
 std::string schema_string_impl(const std::vector<std::string>& column_names)
 {
-    std::string result = get_type_str<T>() + " " + column_names[idx] + "\n";
+    std::string result = std::string(type_str_v<T>) + " " + column_names[idx] + "\n";
     if constexpr (sizeof...(Args) == 0)
     {
         return result;
@@ -400,11 +1185,11 @@ public:
         #ifdef MMAPPET_USE_UNIX_FILEOPS
         file_descriptor = open((filepath / (std::to_string(col_nr) + ".bin")).c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
         if (file_descriptor == -1)
-            throw std::runtime_error("Failed to open file for writing: " + (filepath / (std::to_string(col_nr) + ".bin")).string() + ", error: " + std::strerror(errno));
+            throw_file_error("Failed to open file for writing", filepath / (std::to_string(col_nr) + ".bin"));
         #else
         file.open(filepath / (std::to_string(col_nr) + ".bin"), std::ios::out | std::ios::binary | std::ios::trunc);
         if(!file.is_open())
-            throw std::runtime_error("Failed to open file for writing: " + (filepath / (std::to_string(col_nr) + ".bin")).string() + ", error: " + std::strerror(errno));
+            throw_file_error("Failed to open file for writing", filepath / (std::to_string(col_nr) + ".bin"));
         file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
         #endif
     }
@@ -435,6 +1220,27 @@ public:
 };
 
 
+// Rows of several groups gathered into contiguous columns: the i-th requested group
+// occupies rows [offsets[i], offsets[i + 1]) of every column.
+template<typename T, typename... Args>
+struct GatheredGroups {
+    std::vector<size_t> offsets;
+    std::tuple<std::vector<T>, std::vector<Args>...> columns;
+
+    size_t number_of_groups() const noexcept {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    std::tuple<std::span<const T>, std::span<const Args>...> get_group(size_t group_index) const
+    {
+        const size_t start = offsets[group_index];
+        const size_t length = offsets[group_index + 1] - start;
+        return std::apply([&](const auto&... column) {
+            return std::make_tuple(std::span(column.data() + start, length)...);
+        }, columns);
+    }
+};
+
 template<typename T, typename... Args>
 class IndexedDataset {
     Dataset<T, Args...> dataset;
@@ -461,6 +1267,20 @@ public:
         return index_data.size() > 0 ? index_data.size() - 1 : 0;
     }
 
+    // Copies the rows of groups group_ids, in the order given, into contiguous columns
+    GatheredGroups<T, Args...> gather_groups(std::span<const size_t> group_ids, GatherMode mode = GatherMode::Default)
+    {
+        GatheredGroups<T, Args...> result;
+        result.offsets = gathered_group_offsets(index_ptr, number_of_groups(), dataset.size(), group_ids);
+        std::apply([&](auto&... columns) { (columns.resize(result.offsets.back()), ...); }, result.columns);
+        const auto [columns, itemsizes] = dataset.raw_columns();
+        const auto out_ptrs = std::apply([](auto&... columns) {
+            return std::array<std::byte*, sizeof...(Args) + 1>{reinterpret_cast<std::byte*>(columns.data())...};
+        }, result.columns);
+        gather_groups_raw(columns, itemsizes, index_ptr, number_of_groups(), group_ids, result.offsets, out_ptrs, mode);
+        return result;
+    }
+
 private:
     template<size_t idx, typename U, typename... Rest>
     auto get_group_impl(size_t start, size_t end)
@@ -506,16 +1326,24 @@ public:
 };
 
 
+template<typename T, typename... Args>
+class Snapshot;
+
+template<typename T, typename... Args>
+class VersionedWriter;
+
 template<typename T, typename... Args>
 class Schema
 {
     std::vector<std::string> column_names;
+    SchemaColumns columns;
+    std::string expected_schema_text;
 
 
     template<size_t idx, typename U, typename... Rest>
     std::string schema_string_impl() const
     {
-        std::string result = get_type_str<U>() + " " + column_names[idx] + "\n";
+        std::string result = std::string(type_str_v<U>) + " " + column_names[idx] + "\n";
         if constexpr (sizeof...(Rest) == 0)
         {
             return result;
@@ -528,50 +1356,89 @@ class Schema
     }
 
     template<size_t... Is>
-    auto open_dataset_impl(const std::filesystem::path& filepath,
-                           int open_flags,
-                           int mmap_prot,
-                           int mmap_flags,
-                           std::index_sequence<Is...>)
+    SchemaColumns schema_columns_impl(std::index_sequence<Is...>) const
     {
-        return OpenDataset<T, Args...>(filepath, {column_names[Is]...}, open_flags, mmap_prot, mmap_flags);
+        return { {std::string(type_str_v<std::tuple_element_t<Is, std::tuple<T, Args...>>>), column_names[Is]}... };
     }
 
     public:
+    // schema.txt of a dataset written with this schema: by the C++ writer, or by the Python one (no final newline)
+    bool matches_schema_text(std::string_view text) const noexcept
+    {
+        std::string_view expected = expected_schema_text;
+        return text == expected || text == expected.substr(0, expected.size() - 1);
+    }
+
     template<typename... Strings>
     Schema(const Strings&... col_names)
-    { (column_names.push_back(col_names), ...);}
+    {
+        (column_names.push_back(col_names), ...);
+        columns = schema_columns_impl(std::make_index_sequence<sizeof...(Args)+1>{});
+        expected_schema_text = schema_string();
+    }
+
+    auto open_dataset(const std::filesystem::path& filepath, bool readonly = true, MapMode mode = MapMode::Default) const
+    {
+        int open_flags = readonly ? O_RDONLY : O_RDWR;
+        int mmap_prot = readonly ? PROT_READ : (PROT_READ | PROT_WRITE);
+        int mmap_flags = MAP_SHARED;
+        return open_dataset_flags(filepath, open_flags, mmap_prot, mmap_flags, mode);
+    }
 
-    auto open_dataset(const std::filesystem::path& filepath, bool readonly = true)
+    // dirfd must be an open file descriptor of the dataset directory filepath. Services opening many
+    // datasets can keep the directory open and skip the path lookups of open_dataset(). Only columns
+    // mapped during the call benefit: with MapMode::Lazy or Parallel, columns are opened by path when
+    // mapped, so they are looked up again, and a renamed or replaced directory is not noticed.
+    auto open_dataset_at(int dirfd, const std::filesystem::path& filepath, bool readonly = true, MapMode mode = MapMode::Default) const
     {
         int open_flags = readonly ? O_RDONLY : O_RDWR;
         int mmap_prot = readonly ? PROT_READ : (PROT_READ | PROT_WRITE);
         int mmap_flags = MAP_SHARED;
-        return open_dataset_flags(filepath, open_flags, mmap_prot, mmap_flags);
+        return open_dataset_flags_at(dirfd, filepath, open_flags, mmap_prot, mmap_flags, mode);
     }
 
     auto open_dataset_flags(const std::filesystem::path& filepath,
                            int open_flags,
                            int mmap_prot,
-                           int mmap_flags)
+                           int mmap_flags,
+                           MapMode mode = MapMode::Default) const
     {
-        return open_dataset_impl(filepath, open_flags, mmap_prot, mmap_flags, std::make_index_sequence<sizeof...(Args)+1>{});
+        DirectoryHandle dir(filepath);
+        return open_dataset_flags_at(dir.get(), filepath, open_flags, mmap_prot, mmap_flags, mode);
     }
 
-    auto open_indexed_dataset(const std::filesystem::path& filepath, bool readonly = true)
+    auto open_dataset_flags_at(int dirfd,
+                               const std::filesystem::path& filepath,
+                               int open_flags,
+                               int mmap_prot,
+                               int mmap_flags,
+                               MapMode mode = MapMode::Default) const
+    {
+        // Reuse the columns parsed at construction if schema.txt is byte-identical to what we would write
+        std::string text = read_schema_text(filepath, dirfd);
+        if(matches_schema_text(text))
+            return Dataset<T, Args...>(filepath, columns, 0, open_flags, mmap_prot, mmap_flags, dirfd, mode);
+
+        SchemaColumns file_columns = parse_schema_text(text);
+        check_column_names(column_names, file_columns);
+        return Dataset<T, Args...>(filepath, file_columns, 0, open_flags, mmap_prot, mmap_flags, dirfd, mode);
+    }
+
+    auto open_indexed_dataset(const std::filesystem::path& filepath, bool readonly = true, MapMode mode = MapMode::Default) const
     {
         int open_flags = readonly ? O_RDONLY : O_RDWR;
         int mmap_prot = readonly ? PROT_READ : (PROT_READ | PROT_WRITE);
         int mmap_flags = MAP_SHARED;
-        auto ds = open_dataset_flags(filepath, open_flags, mmap_prot, mmap_flags);
-        auto index_ds = OpenDataset<size_t>(filepath / "index.mmappet", {"Index"}, O_RDONLY, PROT_READ, MAP_SHARED);
+        static const Schema<size_t> index_schema("Index");
+        auto ds = open_dataset_flags(filepath, open_flags, mmap_prot, mmap_flags, mode);
+        auto index_ds = index_schema.open_dataset_flags(filepath / "index.mmappet", O_RDONLY, PROT_READ, MAP_SHARED, mode);
         return IndexedDataset<T, Args...>(std::move(ds), std::move(index_ds));
     }
 
 
-    auto get_columns(const std::filesystem::path& filepath, bool readonly = true)
+    auto get_columns(const std::filesystem::path& filepath, bool readonly = true, MapMode mode = MapMode::Default) const
     {
-        auto dataset = open_dataset(filepath, readonly);
+        auto dataset = open_dataset(filepath, readonly, mode);
         return dataset.move_columns();
     }
 
@@ -585,7 +1452,7 @@ class Schema
         std::ofstream file;
         file.open(filepath, std::ios::out |  std::ios::trunc | std::ios::binary);
         if(!file.is_open())
-            throw std::runtime_error("Failed to open schema file for writing: " + filepath.string() + ", error: " + std::strerror(errno));
+            throw_file_error("Failed to open schema file for writing", filepath);
         file << schema_string();
         file.close();
     }
@@ -605,4 +1472,439 @@ class Schema
         return IndexedWriter<T, Args...>(std::move(writer), std::move(index_writer));
     }
 
+    // Versioned datasets: see VersionedWriter for the layout
+    Snapshot<T, Args...> open_snapshot(const std::filesystem::path& filepath, MapMode mode = MapMode::Default) const
+    {
+        return Snapshot<T, Args...>(*this, filepath, mode);
+    }
+
+    VersionedWriter<T, Args...> open_versioned_writer(const std::filesystem::path& filepath) const
+    {
+        return VersionedWriter<T, Args...>(*this, filepath);
+    }
+
+};
+
+
+// Parses names like "manifest.12" into 12
+static inline bool parse_numbered_name(std::string_view name, std::string_view prefix, size_t& number)
+{
+    if(name.size() <= prefix.size() || name.substr(0, prefix.size()) != prefix)
+        return false;
+    number = 0;
+    for(char c : name.substr(prefix.size()))
+    {
+        if(c < '0' || c > '9')
+            return false;
+        number = number * 10 + (c - '0');
+    }
+    return true;
+}
+
+static inline std::vector<std::string> parse_manifest_text(std::string_view text)
+{
+    std::vector<std::string> segments;
+    while(!text.empty())
+    {
+        size_t eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+        if(!line.empty())
+            segments.emplace_back(line);
+    }
+    return segments;
+}
+
+static inline void fsync_path(const std::filesystem::path& filepath)
+{
+    int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        throw_file_error("Failed to open file", filepath);
+    int result = fsync(fd);
+    int saved_errno = errno;
+    close(fd);
+    if(result == -1)
+        throw_file_error("Failed to fsync file", filepath, saved_errno);
+}
+
+// Replaces the file `name` in the directory dirfd (of path dirpath) with content, atomically: readers
+// see either the old or the new file. The caller must fsync the directory to make the rename durable.
+static inline void replace_file_durably(int dirfd, const std::filesystem::path& dirpath, const std::string& name, std::string_view content)
+{
+    const std::string tmp_name = name + ".tmp";
+    int fd = openat(dirfd, tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fd == -1)
+        throw_file_error("Failed to open file for writing", dirpath / tmp_name);
+    size_t written = 0;
+    while(written < content.size())
+    {
+        ssize_t result = write(fd, content.data() + written, content.size() - written);
+        if(result == -1 && errno == EINTR)
+            continue;
+        if(result == -1)
+        {
+            int saved_errno = errno;
+            close(fd);
+            throw_file_error("Failed to write data to file", dirpath / tmp_name, saved_errno);
+        }
+        written += result;
+    }
+    if(fsync(fd) == -1)
+    {
+        int saved_errno = errno;
+        close(fd);
+        throw_file_error("Failed to fsync file", dirpath / tmp_name, saved_errno);
+    }
+    close(fd);
+    if(renameat(dirfd, tmp_name.c_str(), dirfd, name.c_str()) == -1)
+        throw std::filesystem::filesystem_error("Failed to rename", dirpath / tmp_name, dirpath / name, std::error_code(errno, std::generic_category()));
+}
+
+// Copies src to dst, which must not exist. Where the filesystem supports reflinks (FICLONE: btrfs, XFS, ...)
+// the copy shares extents with src and costs no data copying; blocks are only duplicated when written to.
+static inline void clone_file(const std::filesystem::path& src, const std::filesystem::path& dst)
+{
+#ifdef FICLONE
+    int src_fd = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if(src_fd == -1)
+        throw_file_error("Failed to open file", src);
+    int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(dst_fd == -1)
+    {
+        int saved_errno = errno;
+        close(src_fd);
+        throw_file_error("Failed to open file for writing", dst, saved_errno);
+    }
+    bool cloned = ioctl(dst_fd, FICLONE, src_fd) == 0;
+    close(dst_fd);
+    close(src_fd);
+    if(cloned)
+        return;
+    std::filesystem::remove(dst);
+#endif
+    std::filesystem::copy_file(src, dst);
+}
+
+
+// A consistent, read-only view of one generation of a versioned dataset. Its segments stay mapped and
+// on disk for as long as the Snapshot lives, whatever writers publish or collect in the meantime.
+template<typename T, typename... Args>
+class Snapshot {
+    int manifest_fd = -1; // Shared flock() on manifest.<generation> pins it against collect_garbage()
+    size_t snapshot_generation = 0;
+    std::vector<Dataset<T, Args...>> segment_data;
+    std::vector<size_t> offsets; // Segment i holds rows [offsets[i], offsets[i + 1])
+
+public:
+    Snapshot(const Schema<T, Args...>& schema, const std::filesystem::path& filepath, MapMode mode = MapMode::Default)
+    {
+        DirectoryHandle dir(filepath);
+        // A writer may collect the generation named by CURRENT before we lock its manifest: then try again
+        for(int attempt = 0; manifest_fd == -1; ++attempt)
+        {
+            if(attempt == 100)
+                throw std::runtime_error("Failed to pin a generation of versioned dataset: " + filepath.string());
+            const size_t generation = std::stoull(read_text_file(filepath, "CURRENT", dir.get()));
+            const std::string name = "manifest." + std::to_string(generation);
+            int fd = openat(dir.get(), name.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd == -1 && errno == ENOENT)
+                continue;
+            if(fd == -1)
+                throw_file_error("Failed to open file", filepath / name);
+            struct stat st;
+            if(flock(fd, LOCK_SH) == -1 || fstat(fd, &st) == -1)
+            {
+                int saved_errno = errno;
+                close(fd);
+                throw_file_error("Failed to lock file", filepath / name, saved_errno);
+            }
+            if(st.st_nlink == 0)
+            {
+                close(fd);
+                continue;
+            }
+            manifest_fd = fd;
+            snapshot_generation = generation;
+        }
+
+        try {
+            const auto segments = parse_manifest_text(read_fd_text(manifest_fd, filepath / ("manifest." + std::to_string(snapshot_generation))));
+            segment_data.reserve(segments.size());
+            offsets.push_back(0);
+            for(const auto& segment : segments)
+            {
+                segment_data.push_back(schema.open_dataset(filepath / segment, true, mode));
+                offsets.push_back(offsets.back() + segment_data.back().size());
+            }
+        } catch(...) {
+            close(manifest_fd);
+            throw;
+        }
+    }
+
+    ~Snapshot() noexcept
+    {
+        if(manifest_fd != -1)
+            close(manifest_fd);
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    Snapshot(Snapshot&& other) noexcept :
+        manifest_fd(other.manifest_fd),
+        snapshot_generation(other.snapshot_generation),
+        segment_data(std::move(other.segment_data)),
+        offsets(std::move(other.offsets))
+    {
+        other.manifest_fd = -1;
+    }
+    Snapshot& operator=(Snapshot&&) = delete;
+
+    size_t generation() const noexcept
+    {
+        return snapshot_generation;
+    }
+
+    size_t size() const noexcept
+    {
+        return offsets.back();
+    }
+
+    size_t number_of_segments() const noexcept
+    {
+        return segment_data.size();
+    }
+
+    // Segment segment_nr holds rows [segment_offset(segment_nr), segment_offset(segment_nr + 1)) of the snapshot
+    size_t segment_offset(size_t segment_nr) const
+    {
+        return offsets[segment_nr];
+    }
+
+    Dataset<T, Args...>& segment(size_t segment_nr)
+    {
+        return segment_data[segment_nr];
+    }
+
+    std::tuple<T, Args...> operator[](size_t index)
+    {
+        const size_t segment_nr = std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+        return segment_data[segment_nr][index - offsets[segment_nr]];
+    }
+};
+
+
+// Writes a versioned dataset, laid out as
+//   schema.txt      schema of all segments
+//   seg.<id>/       immutable segments, each a plain dataset that can be opened on its own
+//   manifest.<gen>  segment directories making up generation <gen>, one per line
+//   CURRENT         number of the current generation, replaced atomically with rename()
+//   LOCK            held with flock() by the one VersionedWriter allowed at a time
+// Every change writes new segments and publishes a new generation, so readers (Snapshot) never
+// see segments change or shrink under them, unlike with open_dataset(path, false) and resize().
+template<typename T, typename... Args>
+class VersionedWriter {
+    Schema<T, Args...> schema;
+    const std::filesystem::path filepath;
+    DirectoryHandle dir;
+    int lock_fd = -1;
+    size_t current_generation = 0;
+    std::vector<std::string> current_segments;
+    size_t next_segment_id = 0;
+
+    static const std::filesystem::path& create_directory(const std::filesystem::path& filepath)
+    {
+        std::filesystem::create_directories(filepath);
+        return filepath;
+    }
+
+public:
+    VersionedWriter(const Schema<T, Args...>& schema, const std::filesystem::path& filepath) :
+        schema(schema),
+        filepath(filepath),
+        dir(create_directory(filepath))
+    {
+        lock_fd = openat(dir.get(), "LOCK", O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if(lock_fd == -1)
+            throw_file_error("Failed to open file", filepath / "LOCK");
+        try {
+            if(flock(lock_fd, LOCK_EX) == -1)
+                throw_file_error("Failed to lock file", filepath / "LOCK");
+
+            if(!std::filesystem::exists(filepath / "schema.txt"))
+                schema.write_schema_file(filepath / "schema.txt");
+            else if(!schema.matches_schema_text(read_schema_text(filepath, dir.get())))
+                throw std::runtime_error("Schema mismatch for versioned dataset: " + filepath.string());
+
+            for(const auto& entry : std::filesystem::directory_iterator(filepath))
+            {
+                size_t segment_id;
+                if(parse_numbered_name(entry.path().filename().string(), "seg.", segment_id))
+                    next_segment_id = std::max(next_segment_id, segment_id + 1);
+            }
+
+            if(std::filesystem::exists(filepath / "CURRENT"))
+            {
+                current_generation = std::stoull(read_text_file(filepath, "CURRENT", dir.get()));
+                current_segments = parse_manifest_text(read_text_file(filepath, ("manifest." + std::to_string(current_generation)).c_str(), dir.get()));
+            }
+            else
+                publish_generation(0, {});
+            // Whatever a writer that died left behind
+            collect_garbage();
+        } catch(...) {
+            close(lock_fd);
+            throw;
+        }
+    }
+
+    ~VersionedWriter() noexcept
+    {
+        close(lock_fd);
+    }
+
+    VersionedWriter(const VersionedWriter&) = delete;
+    VersionedWriter& operator=(const VersionedWriter&) = delete;
+
+    size_t generation() const noexcept
+    {
+        return current_generation;
+    }
+
+    const std::vector<std::string>& segments() const noexcept
+    {
+        return current_segments;
+    }
+
+    // Writes a new segment by calling fill(DatasetWriter<T, Args...>&), then publishes a generation ending with it
+    template<typename F>
+    void append_segment(F&& fill)
+    {
+        const std::string name = "seg." + std::to_string(next_segment_id++);
+        try {
+            {
+                auto writer = schema.create_writer(filepath / name);
+                fill(writer);
+            }
+            sync_segment(name);
+        } catch(...) {
+            std::filesystem::remove_all(filepath / name);
+            throw;
+        }
+        auto segments = current_segments;
+        segments.push_back(name);
+        publish(std::move(segments));
+    }
+
+    void append_rows(size_t n, const T* values, const Args*... args)
+    {
+        append_segment([&](DatasetWriter<T, Args...>& writer) { writer.write_rows(n, values, args...); });
+    }
+
+    // Clones segment segment_nr (sharing its blocks where the filesystem supports reflinks), calls
+    // edit(Dataset<T, Args...>&) on the clone opened read-write, and publishes a generation using the clone
+    template<typename F>
+    void edit_segment(size_t segment_nr, F&& edit)
+    {
+        if(segment_nr >= current_segments.size())
+            throw std::out_of_range("Segment index out of range in VersionedWriter::edit_segment");
+        const std::string name = "seg." + std::to_string(next_segment_id++);
+        const std::filesystem::path source = filepath / current_segments[segment_nr];
+        try {
+            std::filesystem::create_directory(filepath / name);
+            clone_file(source / "schema.txt", filepath / name / "schema.txt");
+            for(size_t col_nr = 0; col_nr < sizeof...(Args) + 1; ++col_nr)
+                clone_file(source / (std::to_string(col_nr) + ".bin"), filepath / name / (std::to_string(col_nr) + ".bin"));
+            {
+                auto dataset = schema.open_dataset(filepath / name, false);
+                edit(dataset);
+            }
+            sync_segment(name);
+        } catch(...) {
+            std::filesystem::remove_all(filepath / name);
+            throw;
+        }
+        auto segments = current_segments;
+        segments[segment_nr] = name;
+        publish(std::move(segments));
+    }
+
+    // Removes manifests of older generations that no Snapshot holds, then segments that no remaining
+    // manifest refers to, and the *.tmp files of replace_file_durably() calls that never got to rename.
+    // Runs on opening and after every publish; returns the number of files and segments removed.
+    size_t collect_garbage()
+    {
+        size_t removed = 0;
+        std::vector<std::string> live_segments = current_segments;
+        std::vector<std::string> segment_names;
+        for(const auto& entry : std::filesystem::directory_iterator(filepath))
+        {
+            const std::string name = entry.path().filename().string();
+            // Only the writer holding LOCK writes these, and it has renamed its own by now
+            if(name.ends_with(".tmp"))
+            {
+                removed += unlinkat(dir.get(), name.c_str(), 0) == 0 ? 1 : 0;
+                continue;
+            }
+            size_t number;
+            if(parse_numbered_name(name, "seg.", number))
+                segment_names.push_back(name);
+            if(!parse_numbered_name(name, "manifest.", number) || number == current_generation)
+                continue;
+
+            int fd = openat(dir.get(), name.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd == -1)
+                continue;
+            // Unlink while holding the lock: a Snapshot that opened the file meanwhile sees st_nlink == 0
+            if(flock(fd, LOCK_EX | LOCK_NB) == 0)
+            {
+                unlinkat(dir.get(), name.c_str(), 0);
+                ++removed;
+            }
+            else
+            {
+                auto pinned = parse_manifest_text(read_fd_text(fd, filepath / name));
+                live_segments.insert(live_segments.end(), pinned.begin(), pinned.end());
+            }
+            close(fd);
+        }
+
+        std::sort(live_segments.begin(), live_segments.end());
+        for(const auto& name : segment_names)
+            if(!std::binary_search(live_segments.begin(), live_segments.end(), name))
+            {
+                std::filesystem::remove_all(filepath / name);
+                ++removed;
+            }
+        return removed;
+    }
+
+private:
+    void sync_segment(const std::string& name)
+    {
+        const std::filesystem::path segment_path = filepath / name;
+        for(size_t col_nr = 0; col_nr < sizeof...(Args) + 1; ++col_nr)
+            fsync_path(segment_path / (std::to_string(col_nr) + ".bin"));
+        fsync_path(segment_path / "schema.txt");
+        fsync_path(segment_path);
+    }
+
+    void publish_generation(size_t generation, std::vector<std::string> segments)
+    {
+        std::string manifest;
+        for(const auto& segment : segments)
+            manifest += segment + "\n";
+        replace_file_durably(dir.get(), filepath, "manifest." + std::to_string(generation), manifest);
+        replace_file_durably(dir.get(), filepath, "CURRENT", std::to_string(generation) + "\n");
+        if(fsync(dir.get()) == -1)
+            throw_file_error("Failed to fsync directory", filepath);
+        current_generation = generation;
+        current_segments = std::move(segments);
+    }
+
+    void publish(std::vector<std::string> segments)
+    {
+        publish_generation(current_generation + 1, std::move(segments));
+        collect_garbage();
+    }
 };
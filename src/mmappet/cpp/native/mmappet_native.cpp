@@ -0,0 +1,811 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <mmappet/mmappet.h>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+// Python bindings for the C++ reader and the batched helpers of mmappet.h, used by mmappet/native.py.
+// The schema is only known at runtime here, so columns are mapped as raw bytes of a given item size:
+// the Python side reads schema.txt and gives the zero-copy buffers their numpy dtype.
+
+namespace {
+
+using RawColumn = MMappedData<std::byte>;
+
+enum class ReduceOp { Count, Sum, Mean, Min, Max };
+
+void set_python_error(std::exception_ptr error)
+{
+    try {
+        std::rethrow_exception(error);
+    } catch(const std::out_of_range& e) {
+        PyErr_SetString(PyExc_IndexError, e.what());
+    } catch(const std::invalid_argument& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch(const std::bad_alloc&) {
+        PyErr_NoMemory();
+    } catch(const std::filesystem::filesystem_error& e) {
+        // As OSError(errno, strerror, filename), which Python turns into FileNotFoundError etc., like os.open()
+        errno = e.code().value();
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, e.path1().c_str());
+    } catch(const std::system_error& e) {
+        errno = e.code().value();
+        PyErr_SetFromErrno(PyExc_OSError);
+    } catch(const std::exception& e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+    } catch(...) {
+        PyErr_SetString(PyExc_RuntimeError, "Unknown C++ exception");
+    }
+}
+
+// Runs f with the GIL released; returns false with a Python exception set if f threw
+template<typename F>
+bool run_without_gil(F&& f)
+{
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        f();
+    } catch(...) {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if(!error)
+        return true;
+    set_python_error(error);
+    return false;
+}
+
+// Calls f(T{}) with T the C++ type of a numpy dtype, given by its kind character and item size
+template<typename F>
+void with_numeric_type(char kind, size_t itemsize, F&& f)
+{
+    switch(kind)
+    {
+    case 'f':
+        if(itemsize == 4) return f(float{});
+        if(itemsize == 8) return f(double{});
+        break;
+    case 'i':
+        if(itemsize == 1) return f(int8_t{});
+        if(itemsize == 2) return f(int16_t{});
+        if(itemsize == 4) return f(int32_t{});
+        if(itemsize == 8) return f(int64_t{});
+        break;
+    case 'u':
+    case 'b':
+        if(itemsize == 1) return f(uint8_t{});
+        if(itemsize == 2) return f(uint16_t{});
+        if(itemsize == 4) return f(uint32_t{});
+        if(itemsize == 8) return f(uint64_t{});
+        break;
+    }
+    throw std::invalid_argument(std::string("Unsupported column type: kind '") + kind + "', item size " + std::to_string(itemsize));
+}
+
+template<typename T>
+void reduce_groups(const T* values, const size_t* index, size_t begin, size_t end, ReduceOp op, double* out)
+{
+    for(size_t group = begin; group < end; ++group)
+    {
+        const size_t start = index[group];
+        const size_t stop = index[group + 1];
+        if(op == ReduceOp::Count)
+        {
+            out[group] = static_cast<double>(stop - start);
+            continue;
+        }
+        if(start == stop)
+        {
+            out[group] = op == ReduceOp::Sum ? 0.0 : std::numeric_limits<double>::quiet_NaN();
+            continue;
+        }
+        if(op == ReduceOp::Min || op == ReduceOp::Max)
+        {
+            T result = values[start];
+            for(size_t row = start + 1; row < stop; ++row)
+                result = op == ReduceOp::Min ? std::min(result, values[row]) : std::max(result, values[row]);
+            out[group] = static_cast<double>(result);
+            continue;
+        }
+        double sum = 0.0;
+        for(size_t row = start; row < stop; ++row)
+            sum += values[row];
+        out[group] = op == ReduceOp::Mean ? sum / (stop - start) : sum;
+    }
+}
+
+// Columns 0.bin, 1.bin, ... of one dataset directory
+struct NativeDataset {
+    std::vector<RawColumn> columns;
+    std::vector<size_t> itemsizes;
+    size_t no_rows = 0;
+    bool writable = false;
+
+    NativeDataset(const std::filesystem::path& path, std::vector<size_t> column_itemsizes, bool read_write, MapMode mode) :
+        itemsizes(std::move(column_itemsizes)),
+        writable(read_write)
+    {
+        const int open_flags = read_write ? O_RDWR : O_RDONLY;
+        const int mmap_prot = read_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        DirectoryHandle dir(path);
+        columns.reserve(itemsizes.size());
+        for(size_t col_nr = 0; col_nr < itemsizes.size(); ++col_nr)
+        {
+            columns.emplace_back(dir.get(), path, std::to_string(col_nr) + ".bin", open_flags, mmap_prot, MAP_SHARED, mode);
+            if(itemsizes[col_nr] == 0 || columns.back().size() % itemsizes[col_nr] != 0)
+                throw std::runtime_error("File size is not a multiple of element size for file: " + (path / (std::to_string(col_nr) + ".bin")).string());
+            const size_t rows = columns.back().size() / itemsizes[col_nr];
+            if(col_nr == 0)
+                no_rows = rows;
+            else if(rows != no_rows)
+                throw std::runtime_error("Column size mismatch between column 0 and column " + std::to_string(col_nr));
+        }
+        if(has_mode(mode, MapMode::Parallel) && !has_mode(mode, MapMode::Lazy))
+        {
+            if(no_rows * std::accumulate(itemsizes.begin(), itemsizes.end(), size_t(0)) >= MMAPPET_PARALLEL_MAP_MIN_BYTES)
+                parallel_for(columns.size(), [&](size_t ii) { columns[ii].ensure_mapped(); });
+            else
+                ensure_mapped();
+        }
+    }
+
+    // Maps columns deferred by MapMode::Lazy, before a call starts working on them
+    void ensure_mapped() const
+    {
+        for(const auto& column : columns)
+            column.ensure_mapped();
+    }
+
+    const std::byte* column_data(size_t col_nr) const
+    {
+        return columns[col_nr].data();
+    }
+
+    std::vector<const std::byte*> column_pointers() const
+    {
+        std::vector<const std::byte*> pointers;
+        for(const auto& column : columns)
+            pointers.push_back(column.data());
+        return pointers;
+    }
+
+    void gather(const size_t* rows, size_t n, GatherMode mode, const std::vector<std::byte*>& outs) const
+    {
+        gather_rows_raw(column_pointers(), itemsizes, no_rows, std::span(rows, n), outs, mode);
+    }
+
+    // The group boundaries of index (an index.mmappet dataset), all checked against this dataset: O(groups),
+    // so only for callers that read every group anyway
+    const size_t* group_index(const NativeDataset& index) const
+    {
+        const size_t* index_ptr = index_column(index);
+        for(size_t ii = 0; ii < index.no_rows; ++ii)
+            if(index_ptr[ii] > no_rows || (ii > 0 && index_ptr[ii] < index_ptr[ii - 1]))
+                throw std::runtime_error("Corrupted index: group boundaries are not increasing or exceed the dataset");
+        return index_ptr;
+    }
+
+    // Unchecked boundaries of index, for callers that only read some groups and check those
+    static const size_t* index_column(const NativeDataset& index)
+    {
+        if(index.columns.size() != 1 || index.itemsizes[0] != sizeof(size_t))
+            throw std::invalid_argument("Index dataset must have a single 8-byte column");
+        return reinterpret_cast<const size_t*>(index.column_data(0));
+    }
+
+    std::vector<size_t> group_offsets(const NativeDataset& index, const size_t* group_ids, size_t n) const
+    {
+        const size_t no_groups = index.no_rows > 0 ? index.no_rows - 1 : 0;
+        return gathered_group_offsets(index_column(index), no_groups, no_rows, std::span(group_ids, n));
+    }
+
+    void gather_groups(const NativeDataset& index, const size_t* group_ids, size_t n, const std::vector<size_t>& offsets, GatherMode mode, const std::vector<std::byte*>& outs) const
+    {
+        const size_t* index_ptr = reinterpret_cast<const size_t*>(index.column_data(0));
+        gather_groups_raw(column_pointers(), itemsizes, index_ptr, index.no_rows - 1, std::span(group_ids, n), offsets, outs, mode);
+    }
+
+    std::vector<double> reduce_groups_of(const NativeDataset& index, size_t col_nr, char kind, ReduceOp op, GatherMode mode) const
+    {
+        const size_t* index_ptr = group_index(index);
+        const size_t no_groups = index.no_rows > 0 ? index.no_rows - 1 : 0;
+        std::vector<double> result(no_groups);
+        with_numeric_type(kind, itemsizes[col_nr], [&](auto tag) {
+            using T = decltype(tag);
+            const T* values = reinterpret_cast<const T*>(column_data(col_nr));
+            if(has_mode(mode, GatherMode::Parallel) && no_rows >= 2 * MMAPPET_PARALLEL_GATHER_CHUNK && no_groups > 1)
+            {
+                const size_t no_chunks = std::min(no_groups, no_rows / MMAPPET_PARALLEL_GATHER_CHUNK);
+                parallel_for(no_chunks, [&](size_t chunk) {
+                    reduce_groups(values, index_ptr, chunk * no_groups / no_chunks, (chunk + 1) * no_groups / no_chunks, op, result.data());
+                });
+            }
+            else
+                reduce_groups(values, index_ptr, 0, no_groups, op, result.data());
+        });
+        return result;
+    }
+
+    // Rows whose value in column col_nr lies in [bounds[0], bounds[1]], bounds being two values of the column's type.
+    // Inclusive, so that ranges up to the type's maximum can be expressed.
+    std::vector<uint64_t> scan_range(size_t col_nr, char kind, const std::byte* bounds, GatherMode mode) const
+    {
+        std::vector<uint64_t> result;
+        with_numeric_type(kind, itemsizes[col_nr], [&](auto tag) {
+            using T = decltype(tag);
+            T lo, hi;
+            std::memcpy(&lo, bounds, sizeof(T));
+            std::memcpy(&hi, bounds + sizeof(T), sizeof(T));
+            const T* values = reinterpret_cast<const T*>(column_data(col_nr));
+            auto scan = [&](size_t begin, size_t end, std::vector<uint64_t>& out) {
+                for(size_t row = begin; row < end; ++row)
+                    if(values[row] >= lo && values[row] <= hi)
+                        out.push_back(row);
+            };
+            if(has_mode(mode, GatherMode::Parallel) && no_rows >= 2 * MMAPPET_PARALLEL_GATHER_CHUNK)
+            {
+                const size_t no_chunks = (no_rows + MMAPPET_PARALLEL_GATHER_CHUNK - 1) / MMAPPET_PARALLEL_GATHER_CHUNK;
+                std::vector<std::vector<uint64_t>> partial(no_chunks);
+                parallel_for(no_chunks, [&](size_t chunk) {
+                    scan(chunk * MMAPPET_PARALLEL_GATHER_CHUNK, std::min(no_rows, (chunk + 1) * MMAPPET_PARALLEL_GATHER_CHUNK), partial[chunk]);
+                });
+                for(const auto& part : partial)
+                    result.insert(result.end(), part.begin(), part.end());
+            }
+            else
+                scan(0, no_rows, result);
+        });
+        return result;
+    }
+};
+
+
+// ---- Dataset ----
+
+struct DatasetObject {
+    PyObject_HEAD
+    NativeDataset* impl;
+};
+
+PyTypeObject DatasetType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+PyTypeObject ColumnType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+PyTypeObject ColumnAppenderType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+NativeDataset* get_impl(PyObject* obj)
+{
+    if(!PyObject_TypeCheck(obj, &DatasetType) || reinterpret_cast<DatasetObject*>(obj)->impl == nullptr)
+    {
+        PyErr_SetString(PyExc_TypeError, "Expected an open mmappet._mmappet_native.Dataset");
+        return nullptr;
+    }
+    return reinterpret_cast<DatasetObject*>(obj)->impl;
+}
+
+// Views a buffer of (u)int64 ids as size_t; the caller must PyBuffer_Release(view)
+bool get_ids(PyObject* obj, Py_buffer* view, const size_t*& ids, size_t& n)
+{
+    if(PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS) == -1)
+        return false;
+    if(view->len % sizeof(size_t) != 0)
+    {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "Ids must be a contiguous buffer of 8-byte integers");
+        return false;
+    }
+    ids = static_cast<const size_t*>(view->buf);
+    n = view->len / sizeof(size_t);
+    return true;
+}
+
+// Allocates one bytearray per column with room for the given number of rows
+PyObject* new_output_buffers(const NativeDataset& impl, size_t no_rows, std::vector<std::byte*>& outs)
+{
+    PyObject* list = PyList_New(impl.columns.size());
+    if(list == nullptr)
+        return nullptr;
+    for(size_t col_nr = 0; col_nr < impl.columns.size(); ++col_nr)
+    {
+        PyObject* buffer = PyByteArray_FromStringAndSize(nullptr, no_rows * impl.itemsizes[col_nr]);
+        if(buffer == nullptr)
+        {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, col_nr, buffer);
+        outs.push_back(reinterpret_cast<std::byte*>(PyByteArray_AS_STRING(buffer)));
+    }
+    return list;
+}
+
+int Dataset_init(DatasetObject* self, PyObject* args, PyObject* kwds)
+{
+    // Column buffers, numpy arrays and GIL-released calls may still use the current mappings
+    if(self->impl != nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Dataset is already open and cannot be re-initialised");
+        return -1;
+    }
+    static const char* kwlist[] = {"path", "itemsizes", "read_write", "map_mode", nullptr};
+    PyObject* path_bytes = nullptr;
+    PyObject* itemsizes_obj = nullptr;
+    int read_write = 0;
+    unsigned int map_mode = 0;
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "O&O|pI", const_cast<char**>(kwlist),
+                                    PyUnicode_FSConverter, &path_bytes, &itemsizes_obj, &read_write, &map_mode))
+        return -1;
+    std::filesystem::path path(PyBytes_AS_STRING(path_bytes));
+    Py_DECREF(path_bytes);
+
+    PyObject* itemsizes_seq = PySequence_Fast(itemsizes_obj, "itemsizes must be a sequence of integers");
+    if(itemsizes_seq == nullptr)
+        return -1;
+    std::vector<size_t> itemsizes;
+    for(Py_ssize_t ii = 0; ii < PySequence_Fast_GET_SIZE(itemsizes_seq); ++ii)
+    {
+        size_t itemsize = PyLong_AsSize_t(PySequence_Fast_GET_ITEM(itemsizes_seq, ii));
+        if(PyErr_Occurred())
+        {
+            Py_DECREF(itemsizes_seq);
+            return -1;
+        }
+        itemsizes.push_back(itemsize);
+    }
+    Py_DECREF(itemsizes_seq);
+
+    std::unique_ptr<NativeDataset> impl;
+    if(!run_without_gil([&] { impl = std::make_unique<NativeDataset>(path, std::move(itemsizes), read_write, static_cast<MapMode>(map_mode)); }))
+        return -1;
+    // Another thread may have run __init__ while the GIL was released
+    if(self->impl != nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Dataset is already open and cannot be re-initialised");
+        return -1;
+    }
+    self->impl = impl.release();
+    return 0;
+}
+
+void Dataset_dealloc(DatasetObject* self)
+{
+    delete self->impl;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+Py_ssize_t Dataset_len(DatasetObject* self)
+{
+    return self->impl ? static_cast<Py_ssize_t>(self->impl->no_rows) : 0;
+}
+
+struct ColumnObject {
+    PyObject_HEAD
+    PyObject* dataset;
+    size_t col_nr;
+};
+
+PyObject* Dataset_column(DatasetObject* self, PyObject* arg)
+{
+    NativeDataset* impl = get_impl(reinterpret_cast<PyObject*>(self));
+    if(impl == nullptr)
+        return nullptr;
+    size_t col_nr = PyLong_AsSize_t(arg);
+    if(PyErr_Occurred())
+        return nullptr;
+    if(col_nr >= impl->columns.size())
+    {
+        PyErr_SetString(PyExc_IndexError, "Column index out of range");
+        return nullptr;
+    }
+    ColumnObject* column = PyObject_New(ColumnObject, &ColumnType);
+    if(column == nullptr)
+        return nullptr;
+    Py_INCREF(self);
+    column->dataset = reinterpret_cast<PyObject*>(self);
+    column->col_nr = col_nr;
+    return reinterpret_cast<PyObject*>(column);
+}
+
+PyObject* Dataset_gather(DatasetObject* self, PyObject* args)
+{
+    PyObject* ids_obj;
+    unsigned int mode = 0;
+    if(!PyArg_ParseTuple(args, "O|I", &ids_obj, &mode))
+        return nullptr;
+    NativeDataset* impl = get_impl(reinterpret_cast<PyObject*>(self));
+    if(impl == nullptr)
+        return nullptr;
+    Py_buffer ids_view;
+    const size_t* rows;
+    size_t n;
+    if(!get_ids(ids_obj, &ids_view, rows, n))
+        return nullptr;
+
+    std::vector<std::byte*> outs;
+    PyObject* result = new_output_buffers(*impl, n, outs);
+    if(result != nullptr)
+    {
+        try {
+            impl->ensure_mapped();
+        } catch(...) {
+            set_python_error(std::current_exception());
+            Py_CLEAR(result);
+        }
+    }
+    if(result != nullptr && !run_without_gil([&] { impl->gather(rows, n, static_cast<GatherMode>(mode), outs); }))
+        Py_CLEAR(result);
+    PyBuffer_Release(&ids_view);
+    return result;
+}
+
+PyObject* Dataset_gather_groups(DatasetObject* self, PyObject* args)
+{
+    PyObject* index_obj;
+    PyObject* ids_obj;
+    unsigned int mode = 0;
+    if(!PyArg_ParseTuple(args, "OO|I", &index_obj, &ids_obj, &mode))
+        return nullptr;
+    NativeDataset* impl = get_impl(reinterpret_cast<PyObject*>(self));
+    NativeDataset* index = impl ? get_impl(index_obj) : nullptr;
+    if(index == nullptr)
+        return nullptr;
+    Py_buffer ids_view;
+    const size_t* group_ids;
+    size_t n;
+    if(!get_ids(ids_obj, &ids_view, group_ids, n))
+        return nullptr;
+
+    PyObject* result = nullptr;
+    try {
+        impl->ensure_mapped();
+        index->ensure_mapped();
+        std::vector<size_t> offsets = impl->group_offsets(*index, group_ids, n);
+        std::vector<std::byte*> outs;
+        PyObject* columns = new_output_buffers(*impl, offsets[n], outs);
+        PyObject* offsets_obj = PyByteArray_FromStringAndSize(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(size_t));
+        if(columns != nullptr && offsets_obj != nullptr &&
+           run_without_gil([&] { impl->gather_groups(*index, group_ids, n, offsets, static_cast<GatherMode>(mode), outs); }))
+            result = PyTuple_Pack(2, offsets_obj, columns);
+        Py_XDECREF(columns);
+        Py_XDECREF(offsets_obj);
+    } catch(...) {
+        set_python_error(std::current_exception());
+    }
+    PyBuffer_Release(&ids_view);
+    return result;
+}
+
+PyObject* Dataset_group_reduce(DatasetObject* self, PyObject* args)
+{
+    PyObject* index_obj;
+    Py_ssize_t col_nr;
+    int kind;
+    const char* op_name;
+    unsigned int mode = 0;
+    if(!PyArg_ParseTuple(args, "OnCs|I", &index_obj, &col_nr, &kind, &op_name, &mode))
+        return nullptr;
+    NativeDataset* impl = get_impl(reinterpret_cast<PyObject*>(self));
+    NativeDataset* index = impl ? get_impl(index_obj) : nullptr;
+    if(index == nullptr)
+        return nullptr;
+    if(col_nr < 0 || static_cast<size_t>(col_nr) >= impl->columns.size())
+    {
+        PyErr_SetString(PyExc_IndexError, "Column index out of range");
+        return nullptr;
+    }
+    const std::string_view op_str(op_name);
+    ReduceOp op;
+    if(op_str == "count") op = ReduceOp::Count;
+    else if(op_str == "sum") op = ReduceOp::Sum;
+    else if(op_str == "mean") op = ReduceOp::Mean;
+    else if(op_str == "min") op = ReduceOp::Min;
+    else if(op_str == "max") op = ReduceOp::Max;
+    else
+    {
+        PyErr_Format(PyExc_ValueError, "Unknown reduction '%s', expected one of count, sum, mean, min, max", op_name);
+        return nullptr;
+    }
+
+    std::vector<double> result;
+    try {
+        impl->ensure_mapped();
+        index->ensure_mapped();
+    } catch(...) {
+        set_python_error(std::current_exception());
+        return nullptr;
+    }
+    if(!run_without_gil([&] { result = impl->reduce_groups_of(*index, col_nr, static_cast<char>(kind), op, static_cast<GatherMode>(mode)); }))
+        return nullptr;
+    return PyByteArray_FromStringAndSize(reinterpret_cast<const char*>(result.data()), result.size() * sizeof(double));
+}
+
+PyObject* Dataset_scan_range(DatasetObject* self, PyObject* args)
+{
+    Py_ssize_t col_nr;
+    int kind;
+    Py_buffer bounds;
+    unsigned int mode = 0;
+    if(!PyArg_ParseTuple(args, "nCy*|I", &col_nr, &kind, &bounds, &mode))
+        return nullptr;
+    NativeDataset* impl = get_impl(reinterpret_cast<PyObject*>(self));
+    PyObject* result = nullptr;
+    if(impl == nullptr)
+    {
+        PyBuffer_Release(&bounds);
+        return nullptr;
+    }
+    if(col_nr < 0 || static_cast<size_t>(col_nr) >= impl->columns.size())
+        PyErr_SetString(PyExc_IndexError, "Column index out of range");
+    else if(static_cast<size_t>(bounds.len) != 2 * impl->itemsizes[col_nr])
+        PyErr_SetString(PyExc_ValueError, "Bounds must be two values of the column's type");
+    else
+    {
+        std::vector<uint64_t> rows;
+        bool ok = true;
+        try {
+            impl->ensure_mapped();
+        } catch(...) {
+            set_python_error(std::current_exception());
+            ok = false;
+        }
+        if(ok && run_without_gil([&] { rows = impl->scan_range(col_nr, static_cast<char>(kind), static_cast<const std::byte*>(bounds.buf), static_cast<GatherMode>(mode)); }))
+            result = PyByteArray_FromStringAndSize(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(uint64_t));
+    }
+    PyBuffer_Release(&bounds);
+    return result;
+}
+
+PyMethodDef Dataset_methods[] = {
+    {"column", reinterpret_cast<PyCFunction>(Dataset_column), METH_O,
+     "column(i) -> zero-copy buffer over the mapped bytes of column i"},
+    {"gather", reinterpret_cast<PyCFunction>(Dataset_gather), METH_VARARGS,
+     "gather(row_ids, mode=0) -> list of bytearrays, one per column, holding rows row_ids"},
+    {"gather_groups", reinterpret_cast<PyCFunction>(Dataset_gather_groups), METH_VARARGS,
+     "gather_groups(index, group_ids, mode=0) -> (offsets, list of bytearrays) for groups group_ids"},
+    {"group_reduce", reinterpret_cast<PyCFunction>(Dataset_group_reduce), METH_VARARGS,
+     "group_reduce(index, column, kind, op, mode=0) -> float64 bytearray, op applied to every group"},
+    {"scan_range", reinterpret_cast<PyCFunction>(Dataset_scan_range), METH_VARARGS,
+     "scan_range(column, kind, bounds, mode=0) -> uint64 bytearray of rows with bounds[0] <= value <= bounds[1]"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PySequenceMethods Dataset_as_sequence = {};
+
+
+// ---- Column: buffer protocol over one mapped column, keeping its Dataset alive ----
+
+void Column_dealloc(ColumnObject* self)
+{
+    Py_XDECREF(self->dataset);
+    PyObject_Free(self);
+}
+
+int Column_getbuffer(ColumnObject* self, Py_buffer* view, int flags)
+{
+    const NativeDataset& impl = *reinterpret_cast<DatasetObject*>(self->dataset)->impl;
+    const std::byte* data;
+    try {
+        data = impl.column_data(self->col_nr);
+    } catch(...) {
+        set_python_error(std::current_exception());
+        view->obj = nullptr;
+        return -1;
+    }
+    static std::byte empty[1];
+    const Py_ssize_t length = impl.no_rows * impl.itemsizes[self->col_nr];
+    return PyBuffer_FillInfo(view, reinterpret_cast<PyObject*>(self), const_cast<std::byte*>(data ? data : empty),
+                             length, !impl.writable, flags);
+}
+
+PyBufferProcs Column_as_buffer = {};
+
+
+// ---- ColumnAppender: appends whole column buffers to the column files ----
+
+struct ColumnAppenderObject {
+    PyObject_HEAD
+    std::vector<int>* fds;
+};
+
+void ColumnAppender_close_fds(ColumnAppenderObject* self)
+{
+    if(self->fds == nullptr)
+        return;
+    for(int fd : *self->fds)
+        close(fd);
+    delete self->fds;
+    self->fds = nullptr;
+}
+
+int ColumnAppender_init(ColumnAppenderObject* self, PyObject* args, PyObject*)
+{
+    PyObject* paths_obj;
+    if(!PyArg_ParseTuple(args, "O", &paths_obj))
+        return -1;
+    PyObject* paths_seq = PySequence_Fast(paths_obj, "paths must be a sequence");
+    if(paths_seq == nullptr)
+        return -1;
+    ColumnAppender_close_fds(self);
+    self->fds = new std::vector<int>();
+    for(Py_ssize_t ii = 0; ii < PySequence_Fast_GET_SIZE(paths_seq); ++ii)
+    {
+        PyObject* path_bytes;
+        if(!PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(paths_seq, ii), &path_bytes))
+        {
+            Py_DECREF(paths_seq);
+            ColumnAppender_close_fds(self);
+            return -1;
+        }
+        int fd = open(PyBytes_AS_STRING(path_bytes), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if(fd == -1)
+        {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, PySequence_Fast_GET_ITEM(paths_seq, ii));
+            Py_DECREF(path_bytes);
+            Py_DECREF(paths_seq);
+            ColumnAppender_close_fds(self);
+            return -1;
+        }
+        Py_DECREF(path_bytes);
+        self->fds->push_back(fd);
+    }
+    Py_DECREF(paths_seq);
+    return 0;
+}
+
+void ColumnAppender_dealloc(ColumnAppenderObject* self)
+{
+    ColumnAppender_close_fds(self);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+PyObject* ColumnAppender_append(ColumnAppenderObject* self, PyObject* arg)
+{
+    if(self->fds == nullptr)
+    {
+        PyErr_SetString(PyExc_ValueError, "ColumnAppender is closed");
+        return nullptr;
+    }
+    PyObject* buffers_seq = PySequence_Fast(arg, "append() takes a sequence of buffers, one per column");
+    if(buffers_seq == nullptr)
+        return nullptr;
+    const size_t no_columns = self->fds->size();
+    if(static_cast<size_t>(PySequence_Fast_GET_SIZE(buffers_seq)) != no_columns)
+    {
+        Py_DECREF(buffers_seq);
+        PyErr_SetString(PyExc_ValueError, "Number of buffers does not match number of columns");
+        return nullptr;
+    }
+    std::vector<Py_buffer> views(no_columns);
+    size_t no_views = 0;
+    bool ok = true;
+    for(; no_views < no_columns; ++no_views)
+        if(PyObject_GetBuffer(PySequence_Fast_GET_ITEM(buffers_seq, no_views), &views[no_views], PyBUF_C_CONTIGUOUS) == -1)
+        {
+            ok = false;
+            break;
+        }
+
+    const std::vector<int>& fds = *self->fds;
+    ok = ok && run_without_gil([&] {
+        for(size_t col_nr = 0; col_nr < no_columns; ++col_nr)
+        {
+            const char* data = static_cast<const char*>(views[col_nr].buf);
+            size_t remaining = views[col_nr].len;
+            while(remaining > 0)
+            {
+                ssize_t bytes_written = write(fds[col_nr], data, remaining);
+                if(bytes_written == -1 && errno == EINTR)
+                    continue;
+                if(bytes_written == -1)
+                    throw std::system_error(errno, std::generic_category(), "Failed to write data to column " + std::to_string(col_nr));
+                data += bytes_written;
+                remaining -= bytes_written;
+            }
+        }
+    });
+
+    for(size_t ii = 0; ii < no_views; ++ii)
+        PyBuffer_Release(&views[ii]);
+    Py_DECREF(buffers_seq);
+    if(!ok)
+        return nullptr;
+    Py_RETURN_NONE;
+}
+
+PyObject* ColumnAppender_close(ColumnAppenderObject* self, PyObject*)
+{
+    ColumnAppender_close_fds(self);
+    Py_RETURN_NONE;
+}
+
+PyMethodDef ColumnAppender_methods[] = {
+    {"append", reinterpret_cast<PyCFunction>(ColumnAppender_append), METH_O,
+     "append(buffers) -> None, appends one contiguous buffer to each column file, with the GIL released"},
+    {"close", reinterpret_cast<PyCFunction>(ColumnAppender_close), METH_NOARGS,
+     "close() -> None"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+
+PyModuleDef native_module = {
+    PyModuleDef_HEAD_INIT,
+    "mmappet._mmappet_native",
+    "Native reader and writer for mmappet datasets, see mmappet.native",
+    -1,
+    nullptr,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+} // namespace
+
+
+PyMODINIT_FUNC PyInit__mmappet_native()
+{
+    DatasetType.tp_name = "mmappet._mmappet_native.Dataset";
+    DatasetType.tp_basicsize = sizeof(DatasetObject);
+    DatasetType.tp_flags = Py_TPFLAGS_DEFAULT;
+    DatasetType.tp_doc = "Dataset(path, itemsizes, read_write=False, map_mode=0): the columns of a dataset, mapped as raw bytes";
+    DatasetType.tp_new = PyType_GenericNew;
+    DatasetType.tp_init = reinterpret_cast<initproc>(Dataset_init);
+    DatasetType.tp_dealloc = reinterpret_cast<destructor>(Dataset_dealloc);
+    DatasetType.tp_methods = Dataset_methods;
+    Dataset_as_sequence.sq_length = reinterpret_cast<lenfunc>(Dataset_len);
+    DatasetType.tp_as_sequence = &Dataset_as_sequence;
+
+    ColumnType.tp_name = "mmappet._mmappet_native.Column";
+    ColumnType.tp_basicsize = sizeof(ColumnObject);
+    ColumnType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ColumnType.tp_doc = "Zero-copy buffer over one mapped column";
+    ColumnType.tp_dealloc = reinterpret_cast<destructor>(Column_dealloc);
+    Column_as_buffer.bf_getbuffer = reinterpret_cast<getbufferproc>(Column_getbuffer);
+    ColumnType.tp_as_buffer = &Column_as_buffer;
+
+    ColumnAppenderType.tp_name = "mmappet._mmappet_native.ColumnAppender";
+    ColumnAppenderType.tp_basicsize = sizeof(ColumnAppenderObject);
+    ColumnAppenderType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ColumnAppenderType.tp_doc = "ColumnAppender(paths): appends to the column files paths";
+    ColumnAppenderType.tp_new = PyType_GenericNew;
+    ColumnAppenderType.tp_init = reinterpret_cast<initproc>(ColumnAppender_init);
+    ColumnAppenderType.tp_dealloc = reinterpret_cast<destructor>(ColumnAppender_dealloc);
+    ColumnAppenderType.tp_methods = ColumnAppender_methods;
+
+    if(PyType_Ready(&DatasetType) < 0 || PyType_Ready(&ColumnType) < 0 || PyType_Ready(&ColumnAppenderType) < 0)
+        return nullptr;
+
+    PyObject* module = PyModule_Create(&native_module);
+    if(module == nullptr)
+        return nullptr;
+
+    const std::pair<const char*, unsigned> constants[] = {
+        {"MAP_LAZY", static_cast<unsigned>(MapMode::Lazy)},
+        {"MAP_PARALLEL", static_cast<unsigned>(MapMode::Parallel)},
+        {"MAP_HUGE_PAGES", static_cast<unsigned>(MapMode::HugePages)},
+        {"MAP_ANON_HUGE_PAGES", static_cast<unsigned>(MapMode::AnonHugePages)},
+        {"GATHER_BUCKETED", static_cast<unsigned>(GatherMode::Bucketed)},
+        {"GATHER_WILLNEED", static_cast<unsigned>(GatherMode::WillNeed)},
+        {"GATHER_PARALLEL", static_cast<unsigned>(GatherMode::Parallel)},
+    };
+    for(const auto& [name, value] : constants)
+        if(PyModule_AddIntConstant(module, name, value) < 0)
+        {
+            Py_DECREF(module);
+            return nullptr;
+        }
+
+    const std::pair<const char*, PyTypeObject*> types[] = {
+        {"Dataset", &DatasetType},
+        {"Column", &ColumnType},
+        {"ColumnAppender", &ColumnAppenderType},
+    };
+    for(const auto& [name, type] : types)
+    {
+        Py_INCREF(type);
+        if(PyModule_AddObject(module, name, reinterpret_cast<PyObject*>(type)) < 0)
+        {
+            Py_DECREF(type);
+            Py_DECREF(module);
+            return nullptr;
+        }
+    }
+    return module;
+}
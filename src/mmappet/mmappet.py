@@ -6,6 +6,7 @@ from os import PathLike
 import numpy as np
 import numpy.typing as npt
 import pandas as pd
+from . import native
 
 
 def schema_to_str(schema: pd.DataFrame):
@@ -50,6 +51,7 @@ class DatasetWriter:
             raise TypeError("path must be a Path or a string representing a path.")
         self.path = path
         self.files = None
+        self.appender = None
         self.colnames = None
         self.dtypes = None
         self.schema = None
@@ -85,8 +87,10 @@ class DatasetWriter:
         schema_str = schema_to_str(like)
         self.schema = str_to_schema(schema_str)
         lengths = []
+        file_paths = []
         for idx, colname in enumerate(self.schema):
             file_path = self.path / f"{idx}.bin"
+            file_paths.append(file_path)
             self.files.append(open(file_path, "ab", buffering=10240))
             self.colnames.append(colname)
             self.dtypes.append(self.schema[colname].values.dtype)
@@ -98,6 +102,8 @@ class DatasetWriter:
             )
 
         self.length = 0 if lengths == [] else int(lengths[0])
+        if native.available():
+            self.appender = native.ColumnAppender(file_paths)
 
         with open(self.path / "schema.txt", "wt") as f:
             f.write(schema_str)
@@ -118,6 +124,9 @@ class DatasetWriter:
         return res
 
     def close(self):
+        if self.appender is not None:
+            self.appender.close()
+        self.appender = None
         if self.files is not None:
             for file in self.files:
                 file.close()
@@ -147,7 +156,13 @@ class DatasetWriter:
             assert (
                 column.values.dtype == self.dtypes[idx] or len(df) == 0
             ), f"Types don't match: {column.values.dtype} vs {self.dtypes[idx]}"
-            self.files[idx].write(column.values.tobytes())
+        if self.appender is not None:
+            # Write straight from the column arrays; buffered rows from append_row etc. go first
+            self.flush()
+            self.appender.append([np.ascontiguousarray(df[colname].values) for colname in df])
+            return
+        for idx, colname in enumerate(df):
+            self.files[idx].write(df[colname].values.tobytes())
 
     def append_column(self, colname: str, column: Union[npt.NDArray, pd.Series]):
         if isinstance(column, pd.Series):
@@ -199,7 +214,14 @@ class DatasetWriter:
             file.write(dat.tobytes())
 
 
-def open_dataset_dct(path: PathLike, read_write: bool = False, **kwargs):
+def open_dataset_dct(
+    path: PathLike, read_write: bool = False, map_mode: int = 0, **kwargs
+):
+    """Return dataset as dict of colname -> mmapped numpy array. map_mode (native.MAP_*)
+    only applies where the native extension is available."""
+    if native.available():
+        return native.Dataset(path, read_write=read_write, map_mode=map_mode).columns
+
     path = Path(path)
     df = _read_schema_tbl(path)
     new_data = {}
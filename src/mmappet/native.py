@@ -0,0 +1,182 @@
+"""Zero-copy access to datasets through the C++ reader in mmappet.h.
+
+Columns are numpy arrays over the C++ mappings; gathers, scans and per-group
+reductions run in C++ with the GIL released. Only available where the native
+extension was built (POSIX systems), see `available()`.
+"""
+
+from pathlib import Path
+import math
+from os import PathLike
+from typing import Dict, Tuple
+import numpy as np
+import numpy.typing as npt
+
+try:
+    from . import _mmappet_native as _native
+except ImportError:
+    _native = None
+
+# Values of MapMode in mmappet.h, combine with |
+MAP_LAZY = 1  # map each column on first access
+MAP_PARALLEL = 2  # map all columns concurrently on open
+MAP_HUGE_PAGES = 4  # ask for transparent huge pages on the file mappings
+MAP_ANON_HUGE_PAGES = 8  # copy columns into (huge page backed) anonymous memory, read-only
+
+# Values of GatherMode in mmappet.h, combine with |
+GATHER_BUCKETED = 1  # visit ids grouped by position, for locality
+GATHER_WILLNEED = 2  # madvise(MADV_WILLNEED) the pages to be read first
+GATHER_PARALLEL = 4  # split large batches over threads
+
+
+def available() -> bool:
+    return _native is not None
+
+
+def _ids(ids) -> npt.NDArray:
+    ids = np.asarray(ids)
+    if ids.dtype.kind not in "iu":
+        raise TypeError(f"Ids must be integers, got {ids.dtype}")
+    return np.ascontiguousarray(ids, dtype=np.uint64)
+
+
+def _ceil(x):
+    """Smallest integer >= x, or x itself if it is infinite; None for NaN"""
+    if isinstance(x, (int, np.integer)):
+        return int(x)
+    x = float(x)
+    if math.isnan(x):
+        return None
+    return x if math.isinf(x) else math.ceil(x)
+
+
+def _inclusive_bounds(dtype: np.dtype, lo, hi):
+    """The smallest and largest values of dtype with lo <= value < hi, compared exactly
+    (not after converting lo and hi to dtype), or None if there are none."""
+    if dtype.kind == "f":
+        lo, hi = float(lo), float(hi)
+        if math.isnan(lo) or math.isnan(hi):
+            return None
+        with np.errstate(over="ignore"):
+            first, last = dtype.type(lo), dtype.type(hi)
+        if float(first) < lo:
+            first = np.nextafter(first, dtype.type(np.inf))
+        if float(last) >= hi:
+            last = np.nextafter(last, dtype.type(-np.inf))
+        if not float(last) < hi or first > last:
+            return None
+        return first, last
+
+    info_min, info_max = (0, 1) if dtype.kind == "b" else (np.iinfo(dtype).min, np.iinfo(dtype).max)
+    first, last = _ceil(lo), _ceil(hi)
+    if first is None or last is None:
+        return None
+    first, last = max(first, info_min), min(last - 1, info_max)
+    if first > last:
+        return None
+    return int(first), int(last)
+
+
+class Dataset:
+    """A dataset opened through the C++ reader."""
+
+    def __init__(self, path: PathLike, read_write: bool = False, map_mode: int = 0):
+        if _native is None:
+            raise ImportError("mmappet was installed without its native extension")
+        if read_write and map_mode & MAP_ANON_HUGE_PAGES:
+            raise ValueError("MAP_ANON_HUGE_PAGES columns are private copies and cannot be opened read_write")
+        from .mmappet import _read_schema_tbl
+
+        self.path = Path(path)
+        schema = _read_schema_tbl(self.path)
+        self.dtypes = {colname: schema[colname].values.dtype for colname in schema}
+        self.colnames = list(self.dtypes)
+        self._native = _native.Dataset(
+            str(self.path),
+            [dtype.itemsize for dtype in self.dtypes.values()],
+            read_write,
+            map_mode,
+        )
+        self._arrays = {}
+
+    def __len__(self):
+        return len(self._native)
+
+    def __getitem__(self, colname: str) -> npt.NDArray:
+        """Zero-copy array over a column, mapped on first use with MAP_LAZY"""
+        if colname not in self._arrays:
+            col_nr = self.colnames.index(colname)
+            self._arrays[colname] = np.frombuffer(
+                self._native.column(col_nr), dtype=self.dtypes[colname]
+            )
+        return self._arrays[colname]
+
+    @property
+    def columns(self) -> Dict[str, npt.NDArray]:
+        return {colname: self[colname] for colname in self.colnames}
+
+    def _wrap(self, buffers) -> Dict[str, npt.NDArray]:
+        return {
+            colname: np.frombuffer(buffer, dtype=self.dtypes[colname])
+            for colname, buffer in zip(self.colnames, buffers)
+        }
+
+    def gather(self, row_ids, mode: int = 0) -> Dict[str, npt.NDArray]:
+        """Copy rows row_ids of every column into new arrays"""
+        return self._wrap(self._native.gather(_ids(row_ids), mode))
+
+    def scan_range(self, colname: str, lo, hi, mode: int = 0) -> npt.NDArray:
+        """Row numbers where lo <= colname < hi. lo and hi need not be of the column's type:
+        they are compared exactly, as in Python, not wrapped or truncated to it."""
+        dtype = self.dtypes[colname]
+        bounds = _inclusive_bounds(dtype, lo, hi)
+        if bounds is None:
+            return np.empty(0, dtype=np.uint64)
+        bounds = np.array(bounds, dtype=dtype)
+        rows = self._native.scan_range(
+            self.colnames.index(colname), dtype.kind, bounds.tobytes(), mode
+        )
+        return np.frombuffer(rows, dtype=np.uint64)
+
+
+class IndexedDataset(Dataset):
+    """A dataset written by IndexedWriter: rows split into groups by index.mmappet."""
+
+    def __init__(self, path: PathLike, read_write: bool = False, map_mode: int = 0):
+        super().__init__(path, read_write, map_mode)
+        self._index = _native.Dataset(str(self.path / "index.mmappet"), [8], False, map_mode)
+        self.index = np.frombuffer(self._index.column(0), dtype=np.uint64)
+
+    def number_of_groups(self) -> int:
+        return max(len(self.index) - 1, 0)
+
+    def get_group(self, group_index: int) -> Dict[str, npt.NDArray]:
+        """Zero-copy slices of every column for one group"""
+        if not 0 <= group_index < self.number_of_groups():
+            raise IndexError("Group index out of range in IndexedDataset.get_group")
+        start, end = int(self.index[group_index]), int(self.index[group_index + 1])
+        return {colname: self[colname][start:end] for colname in self.colnames}
+
+    def gather_groups(self, group_ids, mode: int = 0) -> Tuple[npt.NDArray, Dict[str, npt.NDArray]]:
+        """Copy the rows of groups group_ids into new arrays. Group i of the result
+        occupies rows offsets[i]:offsets[i + 1]."""
+        offsets, buffers = self._native.gather_groups(self._index, _ids(group_ids), mode)
+        return np.frombuffer(offsets, dtype=np.uint64), self._wrap(buffers)
+
+    def group_reduce(self, colname: str, op: str, mode: int = 0) -> npt.NDArray:
+        """Per-group count, sum, mean, min or max of a column, as float64"""
+        result = self._native.group_reduce(
+            self._index,
+            self.colnames.index(colname),
+            self.dtypes[colname].kind,
+            op,
+            mode,
+        )
+        return np.frombuffer(result, dtype=np.float64)
+
+
+def ColumnAppender(paths):
+    """Appends whole column buffers to the column files at paths, without the GIL"""
+    if _native is None:
+        raise ImportError("mmappet was installed without its native extension")
+    return _native.ColumnAppender([str(path) for path in paths])
@@ -0,0 +1,42 @@
+import os
+import shutil
+import subprocess
+from pathlib import Path
+import pytest
+
+# Checks of the C++ API in mmappet.h: every program in tests/cpp is compiled and run on a scratch
+# directory, and exits non-zero with a message on stderr when one of its checks fails.
+REPO = Path(__file__).resolve().parents[2]
+CXX = os.environ.get("CXX", "c++")
+
+pytestmark = pytest.mark.skipif(
+    os.name != "posix" or shutil.which(CXX) is None, reason="needs a POSIX system with a C++20 compiler"
+)
+
+
+@pytest.mark.parametrize(
+    "program",
+    [
+        "gather_test",  # Dataset::gather, IndexedDataset::gather_groups in every GatherMode
+        "open_test",  # MapMode::Lazy/Parallel, open_dataset_at, OpenColumn, mismatching schema.txt
+        "versioned_test",  # Snapshot pinning and VersionedWriter garbage collection
+    ],
+)
+def test_cpp(program, tmp_path):
+    binary = tmp_path / program
+    subprocess.run(
+        [
+            CXX,
+            "-std=c++20",
+            "-pthread",
+            "-I" + str(REPO / "src" / "mmappet" / "cpp"),
+            str(REPO / "tests" / "cpp" / (program + ".cpp")),
+            "-o",
+            str(binary),
+        ],
+        check=True,
+    )
+    scratch = tmp_path / "scratch"
+    scratch.mkdir()
+    result = subprocess.run([str(binary), str(scratch)], capture_output=True, text=True)
+    assert result.returncode == 0, result.stderr
@@ -0,0 +1,218 @@
+from mmappet import DatasetWriter, native, open_dataset_dct
+import numpy as np
+import pandas as pd
+import pytest
+import tempfile
+import os
+
+pytestmark = pytest.mark.skipif(
+    not native.available(), reason="mmappet built without its native extension"
+)
+
+
+def make_data(n):
+    rng = np.random.default_rng(0)
+    return pd.DataFrame(
+        {
+            "a": np.arange(n, dtype=np.uint32),
+            "b": rng.random(n),
+            "c": rng.integers(-1000, 1000, n, dtype=np.int64),
+            "d": rng.integers(0, 100, n, dtype=np.uint8),
+        }
+    )
+
+
+def write_indexed(path, data, group_sizes):
+    with DatasetWriter(path, overwrite_dir=True) as writer:
+        writer.append_df(data)
+    index = np.concatenate([[0], np.cumsum(group_sizes)]).astype(np.uint64)
+    with DatasetWriter(os.path.join(path, "index.mmappet"), overwrite_dir=True) as writer:
+        writer.append_df(pd.DataFrame({"Index": index}))
+
+
+def test_constants_match_native():
+    from mmappet import _mmappet_native
+
+    for name in [
+        "MAP_LAZY",
+        "MAP_PARALLEL",
+        "MAP_HUGE_PAGES",
+        "MAP_ANON_HUGE_PAGES",
+        "GATHER_BUCKETED",
+        "GATHER_WILLNEED",
+        "GATHER_PARALLEL",
+    ]:
+        assert getattr(native, name) == getattr(_mmappet_native, name)
+
+
+@pytest.mark.parametrize(
+    "map_mode",
+    [0, native.MAP_LAZY, native.MAP_PARALLEL, native.MAP_HUGE_PAGES, native.MAP_ANON_HUGE_PAGES],
+)
+def test_columns_and_gather(map_mode):
+    data = make_data(1000)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.mmappet")
+        with DatasetWriter(path, overwrite_dir=True) as writer:
+            writer.append_df(data)
+            writer.append_row(a=np.uint32(1000), b=0.5, c=np.int64(-1), d=np.uint8(7))
+            writer.append_df(data)
+        expected = pd.concat(
+            [data, pd.DataFrame({"a": [1000], "b": [0.5], "c": [-1], "d": [7]}).astype(data.dtypes), data],
+            ignore_index=True,
+        )
+
+        ds = native.Dataset(path, map_mode=map_mode)
+        assert len(ds) == len(expected)
+        pd.testing.assert_frame_equal(pd.DataFrame(ds.columns), expected)
+
+        row_ids = np.random.default_rng(1).integers(0, len(expected), 5000)
+        for mode in [0, native.GATHER_BUCKETED, native.GATHER_BUCKETED | native.GATHER_WILLNEED, native.GATHER_PARALLEL]:
+            gathered = pd.DataFrame(ds.gather(row_ids, mode))
+            pd.testing.assert_frame_equal(gathered, expected.iloc[row_ids].reset_index(drop=True))
+
+        with pytest.raises(IndexError):
+            ds.gather([len(expected)])
+
+        rows = ds.scan_range("c", -10, 10)
+        np.testing.assert_array_equal(rows, np.flatnonzero((expected.c >= -10) & (expected.c < 10)))
+
+
+def test_indexed_dataset():
+    data = make_data(1000)
+    group_sizes = [0, 5, 1, 300, 94, 0, 600]
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.mmappet")
+        write_indexed(path, data, group_sizes)
+
+        ds = native.IndexedDataset(path)
+        assert ds.number_of_groups() == len(group_sizes)
+        bounds = np.concatenate([[0], np.cumsum(group_sizes)])
+        for group in range(ds.number_of_groups()):
+            pd.testing.assert_frame_equal(
+                pd.DataFrame(ds.get_group(group)),
+                data.iloc[bounds[group] : bounds[group + 1]].reset_index(drop=True),
+            )
+
+        group_ids = [3, 0, 6, 3, 1]
+        for mode in [0, native.GATHER_BUCKETED | native.GATHER_WILLNEED, native.GATHER_PARALLEL]:
+            offsets, columns = ds.gather_groups(group_ids, mode)
+            expected = pd.concat(
+                [data.iloc[bounds[g] : bounds[g + 1]] for g in group_ids], ignore_index=True
+            )
+            np.testing.assert_array_equal(offsets, np.concatenate([[0], np.cumsum([group_sizes[g] for g in group_ids])]))
+            pd.testing.assert_frame_equal(pd.DataFrame(columns), expected)
+
+        for op, fn in [("count", len), ("sum", np.sum), ("mean", np.mean), ("min", np.min), ("max", np.max)]:
+            result = ds.group_reduce("c", op)
+            for group in range(ds.number_of_groups()):
+                values = data.c.values[bounds[group] : bounds[group + 1]]
+                if len(values) == 0 and op in ("mean", "min", "max"):
+                    assert np.isnan(result[group])
+                else:
+                    assert result[group] == pytest.approx(float(fn(values)))
+
+        with pytest.raises(ValueError):
+            ds.group_reduce("c", "median")
+
+
+def test_anon_huge_pages_is_read_only():
+    data = make_data(100)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.mmappet")
+        with DatasetWriter(path, overwrite_dir=True) as writer:
+            writer.append_df(data)
+        with pytest.raises(ValueError):
+            native.Dataset(path, read_write=True, map_mode=native.MAP_ANON_HUGE_PAGES)
+        from mmappet import _mmappet_native
+
+        with pytest.raises(ValueError):
+            _mmappet_native.Dataset(path, [4, 8, 8, 1], True, native.MAP_ANON_HUGE_PAGES)
+        columns = native.Dataset(path, map_mode=native.MAP_ANON_HUGE_PAGES).columns
+        with pytest.raises(ValueError):
+            columns["b"][1] = 99.0
+
+
+def test_dataset_cannot_be_reinitialised():
+    data = make_data(100)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.mmappet")
+        with DatasetWriter(path, overwrite_dir=True) as writer:
+            writer.append_df(data)
+        ds = native.Dataset(path)
+        a = ds["a"]
+        with pytest.raises(RuntimeError):
+            ds._native.__init__(path, [4, 8, 8, 1])
+        np.testing.assert_array_equal(a, data.a.values)
+
+
+@pytest.mark.parametrize(
+    "dtype,values,bounds",
+    [
+        (np.uint32, np.arange(10), [(-1, 5), (-5, -1), (2.5, 7.5), (0, 2**40), (9, 10), (10, 11)]),
+        (np.int32, np.arange(-5, 5), [(0.5, 3), (-0.5, 0.5), (-(2**40), 2**40), (-np.inf, np.inf), (np.nan, 3), (3, 2)]),
+        (np.uint8, np.array([0, 1, 254, 255]), [(200, 1000), (255, 256), (-1, 0), (255.5, 300)]),
+        (np.int64, np.array([-(2**63), -1, 0, 2**63 - 1]), [(-(2**64), 0), (0, 2**64), (-1.5, 0.5)]),
+        (np.uint64, np.array([0, 1, 2**63, 2**64 - 1], dtype=np.uint64), [(-1, 2), (2**63, 2**65), (1.0, 2**63)]),
+        (np.float32, np.array([-np.inf, -1.5, 0.1, 0.5, 1e30, np.inf, np.nan]), [(0.1, 0.5), (-1e300, 1e300), (-np.inf, np.inf), (0.5, 0.5), (np.inf, np.inf), (-1.5, 0.1)]),
+        (np.float64, np.array([-1.5, 0.1, 0.5, 2.0]), [(0.1, 0.5), (-2, 2), (0.0999999999999, 0.5000000001)]),
+    ],
+)
+def test_scan_range_bounds_are_exact(dtype, values, bounds):
+    values = values.astype(dtype)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.mmappet")
+        with DatasetWriter(path, overwrite_dir=True) as writer:
+            writer.append_df(pd.DataFrame({"a": values}))
+        ds = native.Dataset(path)
+        exact = [float(v) if values.dtype.kind == "f" else int(v) for v in values]
+        for lo, hi in bounds:
+            expected = [row for row, v in enumerate(exact) if lo <= v < hi]
+            np.testing.assert_array_equal(ds.scan_range("a", lo, hi), expected, err_msg=f"{lo} <= a < {hi}")
+
+
+def test_gather_groups_checks_requested_boundaries():
+    data = make_data(10)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        path = os.path.join(tmpdir, "test.mmappet")
+        with DatasetWriter(path, overwrite_dir=True) as writer:
+            writer.append_df(data)
+        index = np.array([0, 4, 2, 10, 11], dtype=np.uint64)
+        with DatasetWriter(os.path.join(path, "index.mmappet"), overwrite_dir=True) as writer:
+            writer.append_df(pd.DataFrame({"Index": index}))
+
+        ds = native.IndexedDataset(path)
+        offsets, columns = ds.gather_groups([0])
+        pd.testing.assert_frame_equal(pd.DataFrame(columns), data.iloc[0:4].reset_index(drop=True))
+        for group in [1, 3]:
+            with pytest.raises(OSError, match="Corrupted index"):
+                ds.gather_groups([0, group])
+
+
+def open_error(path, read_write, map_mode=0):
+    with pytest.raises(OSError) as error:
+        open_dataset_dct(path, read_write=read_write, map_mode=map_mode)
+    return type(error.value), error.value.errno, str(error.value.filename)
+
+
+@pytest.mark.parametrize("map_mode", [0, native.MAP_LAZY, native.MAP_PARALLEL])
+def test_open_errors_match_fallback(map_mode, monkeypatch):
+    broken = {
+        "missing": (lambda column: os.remove(column), False),
+        "directory": (lambda column: (os.remove(column), os.mkdir(column)), True),
+    }
+    if os.geteuid() != 0:
+        broken["unreadable"] = (lambda column: os.chmod(column, 0), False)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for name, (breaker, read_write) in broken.items():
+            path = os.path.join(tmpdir, f"{name}.mmappet")
+            with DatasetWriter(path, overwrite_dir=True) as writer:
+                writer.append_df(make_data(10))
+            breaker(os.path.join(path, "1.bin"))
+
+            native_error = open_error(path, read_write, map_mode)
+            with monkeypatch.context() as fallback:
+                fallback.setattr(native, "_native", None)
+                assert open_error(path, read_write) == native_error, name
+            assert native_error[0] is not OSError, name
+            assert native_error[2] == os.path.join(path, "1.bin"), name
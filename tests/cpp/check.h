@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+
+// Assertions for the programs in tests/cpp, which tests/Python/test_cpp.py compiles and runs:
+// a failed check prints its location and exits with status 1.
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            std::exit(1); \
+        } \
+    } while(0)
+
+// Checks that statement throws an exception of type (or derived from) exception_type
+#define CHECK_THROWS(exception_type, statement) \
+    do { \
+        bool threw_ = false; \
+        try { \
+            statement; \
+        } catch(const exception_type&) { \
+            threw_ = true; \
+        } \
+        if(!threw_) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " #exception_type " from " #statement "\n"; \
+            std::exit(1); \
+        } \
+    } while(0)
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <mmappet/mmappet.h>
+#include "check.h"
+
+// Checks Dataset::gather / gather_into and IndexedDataset::gather_groups against get_group and operator[],
+// in every combination of GatherMode flags and with batches large enough for the parallel chunking.
+// Usage: ./gather_test <scratch directory>
+
+using TestSchema = Schema<uint64_t, uint32_t, double, uint8_t>;
+using Columns = std::tuple<std::vector<uint64_t>, std::vector<uint32_t>, std::vector<double>, std::vector<uint8_t>>;
+
+static std::tuple<uint64_t, uint32_t, double, uint8_t> row_values(size_t row)
+{
+    return {row, static_cast<uint32_t>(row * 7), row * 0.5, static_cast<uint8_t>(row % 251)};
+}
+
+static std::tuple<uint64_t, uint32_t, double, uint8_t> column_row(const Columns& columns, size_t row)
+{
+    const auto& [a, b, c, d] = columns;
+    return {a[row], b[row], c[row], d[row]};
+}
+
+int main(int argc, char** argv)
+{
+    CHECK(argc == 2);
+    const std::filesystem::path path = std::filesystem::path(argv[1]) / "gather.mmappet";
+    TestSchema schema("a", "b", "c", "d");
+
+    // Groups of 0 to 6 rows, so that some are empty
+    constexpr size_t no_groups = 100000;
+    size_t no_rows = 0;
+    {
+        auto writer = schema.create_indexed_writer(path);
+        std::vector<uint64_t> a;
+        std::vector<uint32_t> b;
+        std::vector<double> c;
+        std::vector<uint8_t> d;
+        for(size_t group = 0; group < no_groups; ++group)
+        {
+            a.clear(); b.clear(); c.clear(); d.clear();
+            for(size_t ii = 0; ii < group % 7; ++ii, ++no_rows)
+            {
+                auto [va, vb, vc, vd] = row_values(no_rows);
+                a.push_back(va); b.push_back(vb); c.push_back(vc); d.push_back(vd);
+            }
+            writer.write_group(a.size(), a.data(), b.data(), c.data(), d.data());
+        }
+    }
+
+    const GatherMode modes[] = {
+        GatherMode::Default,
+        GatherMode::Bucketed,
+        GatherMode::WillNeed,
+        GatherMode::Parallel,
+        GatherMode::Bucketed | GatherMode::WillNeed,
+        GatherMode::Bucketed | GatherMode::Parallel,
+        GatherMode::WillNeed | GatherMode::Parallel,
+        GatherMode::Bucketed | GatherMode::WillNeed | GatherMode::Parallel,
+    };
+
+    // Random row ids with duplicates, more than enough for GatherMode::Parallel to split them into chunks
+    const size_t no_ids = 2 * MMAPPET_PARALLEL_GATHER_CHUNK + 12345;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto next_random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    std::vector<size_t> row_ids(no_ids);
+    for(auto& row : row_ids)
+        row = next_random() % no_rows;
+    row_ids[1] = row_ids[0];
+    row_ids[2] = no_rows - 1;
+
+    for(MapMode map_mode : {MapMode::Default, MapMode::Lazy})
+    {
+        auto dataset = schema.open_dataset(path, true, map_mode);
+        CHECK(dataset.size() == no_rows);
+        for(GatherMode mode : modes)
+        {
+            Columns gathered = dataset.gather(row_ids, mode);
+            CHECK(std::get<0>(gathered).size() == no_ids && std::get<3>(gathered).size() == no_ids);
+            for(size_t ii = 0; ii < no_ids; ++ii)
+                CHECK(column_row(gathered, ii) == row_values(row_ids[ii]));
+
+            Columns into{std::vector<uint64_t>(10), std::vector<uint32_t>(10), std::vector<double>(10), std::vector<uint8_t>(10)};
+            auto& [a, b, c, d] = into;
+            const std::vector<size_t> few_ids{no_rows - 1, 0, 5, 5, 3};
+            dataset.gather_into(few_ids, a.data(), b.data(), c.data(), d.data(), mode);
+            for(size_t ii = 0; ii < few_ids.size(); ++ii)
+                CHECK(column_row(into, ii) == row_values(few_ids[ii]));
+
+            CHECK(std::get<0>(dataset.gather({}, mode)).empty());
+            const std::vector<size_t> out_of_range{0, no_rows};
+            CHECK_THROWS(std::out_of_range, dataset.gather(out_of_range, mode));
+        }
+    }
+
+    auto indexed = schema.open_indexed_dataset(path);
+    CHECK(indexed.number_of_groups() == no_groups);
+    std::vector<size_t> group_ids(no_ids);
+    for(auto& group : group_ids)
+        group = next_random() % no_groups;
+    group_ids[1] = group_ids[0];
+    group_ids[2] = 0; // empty
+    group_ids[3] = no_groups - 1;
+    for(GatherMode mode : modes)
+    {
+        GatheredGroups<uint64_t, uint32_t, double, uint8_t> gathered = indexed.gather_groups(group_ids, mode);
+        CHECK(gathered.number_of_groups() == no_ids);
+        CHECK(gathered.offsets.size() == no_ids + 1 && gathered.offsets[0] == 0);
+        CHECK(gathered.offsets.back() >= 2 * MMAPPET_PARALLEL_GATHER_CHUNK);
+        for(size_t ii = 0; ii < no_ids; ++ii)
+        {
+            auto [ga, gb, gc, gd] = gathered.get_group(ii);
+            auto [ea, eb, ec, ed] = indexed.get_group(group_ids[ii]);
+            CHECK(std::equal(ga.begin(), ga.end(), ea.begin(), ea.end()));
+            CHECK(std::equal(gb.begin(), gb.end(), eb.begin(), eb.end()));
+            CHECK(std::equal(gc.begin(), gc.end(), ec.begin(), ec.end()));
+            CHECK(std::equal(gd.begin(), gd.end(), ed.begin(), ed.end()));
+        }
+
+        CHECK(indexed.gather_groups({}, mode).number_of_groups() == 0);
+        const std::vector<size_t> out_of_range{0, no_groups};
+        CHECK_THROWS(std::out_of_range, indexed.gather_groups(out_of_range, mode));
+    }
+    CHECK_THROWS(std::out_of_range, indexed.get_group(no_groups));
+
+    std::cout << "gather_test: all checks passed\n";
+}
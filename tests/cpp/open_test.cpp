@@ -0,0 +1,165 @@
+// Small enough that the test datasets fall on both sides of it
+#define MMAPPET_PARALLEL_MAP_MIN_BYTES 4096
+#include <iostream>
+#include <thread>
+#include <mmappet/mmappet.h>
+#include "check.h"
+
+// Checks the ways of opening a dataset: MapMode::Lazy and Parallel, open_dataset_at, OpenColumn with a
+// parsed schema, and schema.txt files that differ from what Schema writes.
+// Usage: ./open_test <scratch directory>
+
+using TestSchema = Schema<uint64_t, double>;
+
+static void write_dataset(TestSchema& schema, const std::filesystem::path& path, size_t no_rows)
+{
+    auto writer = schema.create_writer(path);
+    for(size_t row = 0; row < no_rows; ++row)
+        writer.write_row(row, row * 0.5);
+}
+
+static void check_rows(Dataset<uint64_t, double>& dataset, size_t no_rows)
+{
+    CHECK(dataset.size() == no_rows);
+    for(size_t row = 0; row < no_rows; ++row)
+        CHECK(dataset[row] == std::make_tuple(uint64_t(row), row * 0.5));
+}
+
+static void write_schema_text(const std::filesystem::path& path, const std::string& text)
+{
+    std::ofstream file(path / "schema.txt", std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+static size_t open_fds()
+{
+    size_t count = 0;
+    for(const auto& entry : std::filesystem::directory_iterator("/dev/fd"))
+        count += entry.path().filename() != "." ? 1 : 0;
+    return count;
+}
+
+int main(int argc, char** argv)
+{
+    CHECK(argc == 2);
+    const std::filesystem::path root(argv[1]);
+    TestSchema schema("a", "b");
+    const std::filesystem::path small = root / "small.mmappet"; // 160 bytes
+    const std::filesystem::path large = root / "large.mmappet"; // 160 kB
+    const std::filesystem::path empty = root / "empty.mmappet";
+    write_dataset(schema, small, 10);
+    write_dataset(schema, large, 10000);
+    write_dataset(schema, empty, 0);
+
+    // Every MapMode, below and above MMAPPET_PARALLEL_MAP_MIN_BYTES
+    for(MapMode mode : {MapMode::Default, MapMode::Lazy, MapMode::Parallel, MapMode::Lazy | MapMode::Parallel})
+    {
+        auto small_dataset = schema.open_dataset(small, true, mode);
+        check_rows(small_dataset, 10);
+        auto large_dataset = schema.open_dataset(large, true, mode);
+        check_rows(large_dataset, 10000);
+        auto empty_dataset = schema.open_dataset(empty, true, mode);
+        check_rows(empty_dataset, 0);
+        CHECK(empty_dataset.get_column<0>().data() == nullptr);
+    }
+
+    // Lazy: the first access maps, once, even when several threads make it at the same time
+    const bool can_count_fds = std::filesystem::exists("/dev/fd");
+    const size_t fds_before = can_count_fds ? open_fds() : 0;
+    for(size_t round = 0; round < 50; ++round)
+    {
+        auto dataset = schema.open_dataset(large, true, MapMode::Lazy);
+        std::atomic<size_t> mismatches{0};
+        std::vector<std::thread> threads;
+        for(size_t thread_nr = 0; thread_nr < 8; ++thread_nr)
+            threads.emplace_back([&, thread_nr] {
+                if(dataset[9999 - thread_nr] != std::make_tuple(uint64_t(9999 - thread_nr), (9999 - thread_nr) * 0.5))
+                    ++mismatches;
+            });
+        for(auto& thread : threads)
+            thread.join();
+        CHECK(mismatches == 0);
+    }
+    if(can_count_fds)
+        CHECK(open_fds() == fds_before);
+
+    // Lazy: a column that shrank between open and first access is not mapped past its end
+    {
+        const std::filesystem::path shrinking = root / "shrinking.mmappet";
+        write_dataset(schema, shrinking, 100);
+        auto dataset = schema.open_dataset(shrinking, true, MapMode::Lazy);
+        std::filesystem::resize_file(shrinking / "1.bin", sizeof(double) * 50);
+        CHECK(dataset.get_column<0>()[99] == 99);
+        CHECK_THROWS(std::runtime_error, dataset.get_column<1>().data());
+        CHECK_THROWS(std::runtime_error, dataset[0]);
+    }
+
+    // open_dataset_at: columns are opened relative to the directory fd, also for writing
+    {
+        DirectoryHandle dir(small);
+        auto dataset = schema.open_dataset_at(dir.get(), small);
+        check_rows(dataset, 10);
+        auto lazy = schema.open_dataset_at(dir.get(), small, true, MapMode::Lazy);
+        check_rows(lazy, 10);
+        {
+            auto writable = schema.open_dataset_at(dir.get(), small, false);
+            writable.get_column<1>()[3] = -1.0;
+        }
+        CHECK(std::get<1>(schema.open_dataset(small)[3]) == -1.0);
+        schema.open_dataset_at(dir.get(), small, false).get_column<1>()[3] = 1.5;
+        check_rows(dataset, 10);
+    }
+
+    // OpenColumn with a schema parsed once
+    {
+        const SchemaColumns parsed = read_schema(small);
+        CHECK((parsed == SchemaColumns{{"uint64", "a"}, {"float64", "b"}}));
+        for(MapMode mode : {MapMode::Default, MapMode::Lazy})
+        {
+            auto a = OpenColumn<uint64_t>(small, parsed, "a", O_RDONLY, PROT_READ, MAP_SHARED, mode);
+            auto b = OpenColumn<double>(small, parsed, "b", O_RDONLY, PROT_READ, MAP_SHARED, mode);
+            CHECK(a.size() == 10 && b.size() == 10);
+            for(size_t row = 0; row < 10; ++row)
+                CHECK(a[row] == row && b[row] == row * 0.5);
+        }
+        CHECK_THROWS(std::runtime_error, OpenColumn<uint64_t>(small, parsed, "c"));
+        CHECK_THROWS(std::runtime_error, OpenColumn<uint32_t>(small, parsed, "a"));
+    }
+
+    // schema.txt files that are not byte-identical to what Schema writes
+    // Returns the error of opening path, which must be the same through open_dataset and open_dataset_at
+    auto open_error = [&](const std::filesystem::path& path) -> std::string {
+        std::string errors[2];
+        for(bool at : {false, true})
+        {
+            try {
+                DirectoryHandle dir(path);
+                auto dataset = at ? schema.open_dataset_at(dir.get(), path) : schema.open_dataset(path);
+                check_rows(dataset, 10);
+            } catch(const std::runtime_error& e) {
+                errors[at] = e.what();
+            }
+        }
+        CHECK(errors[0] == errors[1]);
+        return errors[0];
+    };
+    const std::filesystem::path variant = root / "variant.mmappet";
+    write_dataset(schema, variant, 10);
+    // As written by the Python writer, without a final newline
+    write_schema_text(variant, "uint64 a\nfloat64 b");
+    CHECK(open_error(variant).empty());
+    write_schema_text(variant, "uint64 a\n\nfloat64 b\n\n");
+    CHECK(open_error(variant).empty());
+    write_schema_text(variant, "uint64 a\nfloat64 c\n");
+    CHECK(open_error(variant).find("Column name mismatch at column 1: expected 'b', got 'c'") != std::string::npos);
+    write_schema_text(variant, "uint64 a\n");
+    CHECK(open_error(variant).find("Number of column names") != std::string::npos);
+    write_schema_text(variant, "uint64 a\nfloat64 b\nuint8 c\n");
+    CHECK(open_error(variant).find("Number of column names") != std::string::npos);
+    write_schema_text(variant, "uint32 a\nfloat64 b\n");
+    CHECK(open_error(variant).find("Type mismatch for column 0") != std::string::npos);
+    std::filesystem::remove(variant / "schema.txt");
+    CHECK(open_error(variant).find("schema.txt") != std::string::npos);
+
+    std::cout << "open_test: all checks passed\n";
+}
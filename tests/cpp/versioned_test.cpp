@@ -0,0 +1,115 @@
+#include <iostream>
+#include <optional>
+#include <mmappet/mmappet.h>
+#include "check.h"
+
+// Checks the snapshot pinning and garbage collection of versioned datasets. Run by tests/Python/test_cpp.py.
+// Usage: ./versioned_test <scratch directory>
+
+using TestSchema = Schema<size_t, double>;
+
+static void append_batch(VersionedWriter<size_t, double>& writer, size_t first, size_t n)
+{
+    std::vector<size_t> ids(n);
+    std::vector<double> values(n);
+    for(size_t ii = 0; ii < n; ++ii)
+    {
+        ids[ii] = first + ii;
+        values[ii] = (first + ii) * 0.5;
+    }
+    writer.append_rows(n, ids.data(), values.data());
+}
+
+static void check_rows(Snapshot<size_t, double>& snapshot, size_t no_rows, size_t edited_begin = 0, size_t edited_end = 0)
+{
+    CHECK(snapshot.size() == no_rows);
+    for(size_t row = 0; row < no_rows; ++row)
+    {
+        auto [id, value] = snapshot[row];
+        CHECK(id == row);
+        CHECK(value == (row >= edited_begin && row < edited_end ? -1.0 : row * 0.5));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    CHECK(argc == 2);
+    const std::filesystem::path path = std::filesystem::path(argv[1]) / "versioned.mmappet";
+    auto exists = [&](const std::string& name) { return std::filesystem::exists(path / name); };
+    TestSchema schema("Id", "Value");
+
+    {
+        auto writer = schema.open_versioned_writer(path);
+        CHECK(writer.generation() == 0);
+        for(size_t batch = 0; batch < 3; ++batch)
+            append_batch(writer, batch * 4, 4);
+        CHECK(writer.generation() == 3);
+        CHECK((writer.segments() == std::vector<std::string>{"seg.0", "seg.1", "seg.2"}));
+        CHECK(!exists("manifest.0") && !exists("manifest.2"));
+
+        // A snapshot keeps its manifest and segments through several publishes and edits
+        std::optional<Snapshot<size_t, double>> pinned(schema.open_snapshot(path));
+        CHECK(pinned->generation() == 3);
+        CHECK(pinned->number_of_segments() == 3);
+        check_rows(*pinned, 12);
+
+        writer.edit_segment(1, [](Dataset<size_t, double>& segment) {
+            for(size_t ii = 0; ii < segment.size(); ++ii)
+                segment.get_column<1>()[ii] = -1.0;
+        });
+        append_batch(writer, 12, 4);
+        writer.edit_segment(0, [](Dataset<size_t, double>&) {});
+        CHECK(writer.generation() == 6);
+        CHECK((writer.segments() == std::vector<std::string>{"seg.5", "seg.3", "seg.2", "seg.4"}));
+        for(const char* name : {"manifest.3", "seg.0", "seg.1", "seg.2"})
+            CHECK(exists(name));
+        CHECK(!exists("manifest.4") && !exists("manifest.5"));
+
+        // edit_segment works on a copy: the pinned snapshot still sees the old values
+        check_rows(*pinned, 12);
+        auto latest = schema.open_snapshot(path);
+        CHECK(latest.generation() == 6);
+        check_rows(latest, 16, 4, 8);
+
+        // Destroying the snapshot unpins generation 3, which the next publish collects
+        pinned.reset();
+        CHECK(exists("manifest.3"));
+        append_batch(writer, 16, 4);
+        CHECK(!exists("manifest.3"));
+        CHECK(!exists("seg.0") && !exists("seg.1"));
+        // latest still pins generation 6
+        for(const char* name : {"manifest.6", "seg.2", "seg.3", "seg.4", "seg.5"})
+            CHECK(exists(name));
+        check_rows(latest, 16, 4, 8);
+
+        // A failing append_segment removes its segment and publishes nothing
+        CHECK_THROWS(std::runtime_error, writer.append_segment([](DatasetWriter<size_t, double>& segment) {
+            segment.write_row(0, 0.0);
+            throw std::runtime_error("fill failed");
+        }));
+        CHECK(!exists("seg.7"));
+        CHECK(writer.generation() == 7);
+    }
+
+    // What a writer that died mid-publish leaves behind is collected by the next writer
+    std::filesystem::create_directory(path / "seg.99");
+    schema.write_schema_file(path / "seg.99" / "schema.txt");
+    std::ofstream(path / "manifest.8.tmp") << "seg.99\n";
+    std::ofstream(path / "CURRENT.tmp") << "8";
+    {
+        auto writer = schema.open_versioned_writer(path);
+        CHECK(writer.generation() == 7);
+        CHECK(!exists("seg.99") && !exists("manifest.8.tmp") && !exists("CURRENT.tmp"));
+        std::ofstream(path / "CURRENT.tmp") << "8";
+        CHECK(writer.collect_garbage() == 1);
+        CHECK(!exists("CURRENT.tmp"));
+        append_batch(writer, 20, 4);
+        CHECK(writer.segments().back() == "seg.100");
+        // Nothing pins older generations any more
+        CHECK(!exists("manifest.6") && !exists("manifest.7"));
+        auto snapshot = schema.open_snapshot(path);
+        check_rows(snapshot, 24, 4, 8);
+    }
+
+    std::cout << "versioned_test: all checks passed\n";
+}